@@ -11,6 +11,7 @@ LOCAL_PATH := $(JDKSMIDI_PATH)
 LOCAL_MODULE:= jdksmidi
 LOCAL_MODULE_FILENAME:= libjdksmidi
 LOCAL_CFLAGS := -I$(JDKSMIDI_PATH)/include
+LOCAL_CPPFLAGS := -std=c++11
 LOCAL_EXPORT_C_INCLUDES := $(JDKSMIDI_PATH)/include
 
 MY_PREFIX := $(JDKSMIDI_PATH)
@@ -1,7 +1,7 @@
 TOP = ../../..
 
 QT -= core gui
-CONFIG += link_prl debug
+CONFIG += link_prl debug c++11 thread
 win32:QT += core
 win32:CONFIG+=console
 
@@ -2,7 +2,7 @@ QT       -= core gui
 
 TARGET = jdksmidi
 TEMPLATE = lib
-CONFIG += staticlib
+CONFIG += staticlib c++11 thread
 
 DEFINES += 
 
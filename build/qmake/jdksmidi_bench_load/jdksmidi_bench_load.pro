@@ -0,0 +1,15 @@
+CONFIG-=app_bundle
+
+TOP = ../../..
+
+! include( ../common.pri ) {
+  error( need common.pri file )
+}
+
+
+TARGET=jdksmidi_bench_load
+
+SOURCES += $$TOP/examples/jdksmidi_bench_load.cpp
+
+HEADERS += $$TOP/include/*/*.h
+
@@ -0,0 +1,15 @@
+CONFIG-=app_bundle
+
+TOP = ../../..
+
+! include( ../common.pri ) {
+  error( need common.pri file )
+}
+
+
+TARGET=jdksmidi_bench_write
+
+SOURCES += $$TOP/examples/jdksmidi_bench_write.cpp
+
+HEADERS += $$TOP/include/*/*.h
+
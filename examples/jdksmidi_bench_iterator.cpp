@@ -0,0 +1,277 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+//
+// Compare the multitrack iteration throughput of MIDIMultiTrackIterator
+// against the former linear scan of all tracks on every event, on an
+// orchestral sized synthetic multitrack or on a midifile.
+//
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/track.h"
+#include "jdksmidi/multitrack.h"
+#include "jdksmidi/filereadmultitrack.h"
+#include "jdksmidi/fileread.h"
+
+#include <time.h>
+
+using namespace jdksmidi;
+
+// replica of the former iterator, kept here for comparison only
+class LinearScanIterator
+{
+public:
+    LinearScanIterator ( const MIDIMultiTrack *mlt )
+        : multitrack ( mlt ), num_tracks ( mlt->GetNumTracks() ),
+          next_event_number ( num_tracks ), next_event_time ( num_tracks )
+    {
+        GoToZero();
+    }
+
+    void GoToZero()
+    {
+        cur_event_track = 0;
+
+        for ( int i = 0; i < num_tracks; ++i )
+        {
+            next_event_number[i] = -1;
+            next_event_time[i] = 0xffffffff;
+
+            if ( multitrack->GetTrack ( i )->GetNumEvents() > 0 )
+            {
+                next_event_number[i] = 0;
+                next_event_time[i] = multitrack->GetTrack ( i )->GetEventAddress ( 0 )->GetTime();
+            }
+        }
+
+        FindTrackOfFirstEvent();
+    }
+
+    bool GetCurEvent ( int *track, const MIDITimedBigMessage **msg ) const
+    {
+        if ( cur_event_track == -1 )
+            return false;
+
+        *track = cur_event_track;
+        *msg = multitrack->GetTrack ( cur_event_track )->GetEventAddress ( next_event_number[cur_event_track] );
+        return true;
+    }
+
+    bool GoToNextEvent()
+    {
+        if ( cur_event_track == -1 )
+            return false;
+
+        int t = cur_event_track;
+
+        if ( ++next_event_number[t] >= multitrack->GetTrack ( t )->GetNumEvents() )
+            next_event_number[t] = -1;
+        else
+            next_event_time[t] = multitrack->GetTrack ( t )->GetEventAddress ( next_event_number[t] )->GetTime();
+
+        return FindTrackOfFirstEvent() != -1;
+    }
+
+private:
+    int FindTrackOfFirstEvent()
+    {
+        MIDIClockTime minimum_time = 0xffffffff;
+        int minimum_time_track = -1;
+
+        for ( int j = 0; j < num_tracks; ++j )
+        {
+            int i = ( j + cur_event_track + 1 ) % num_tracks;
+
+            if ( next_event_number[i] >= 0 && next_event_time[i] < minimum_time )
+            {
+                minimum_time = next_event_time[i];
+                minimum_time_track = i;
+            }
+        }
+
+        cur_event_track = minimum_time_track;
+        return cur_event_track;
+    }
+
+    const MIDIMultiTrack *multitrack;
+    int num_tracks;
+    int cur_event_track;
+    std::vector< int > next_event_number;
+    std::vector< MIDIClockTime > next_event_time;
+};
+
+static double Seconds ( clock_t start )
+{
+    return double ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+// sections of instruments playing chords on a common beat grid, so many
+// tracks have events at the same times, as in orchestral scores
+static void MakeOrchestra ( MIDIMultiTrack &tracks, int num_tracks, int num_beats )
+{
+    tracks.ClearAndResize ( num_tracks );
+    srand ( 1 );
+
+    for ( int trk = 0; trk < num_tracks; ++trk )
+    {
+        MIDITrack *t = tracks.GetTrack ( trk );
+        unsigned char chan = ( unsigned char ) ( trk % 16 );
+        unsigned char note = ( unsigned char ) ( 36 + trk % 48 );
+        // each section plays notes of 1, 1/2 or 1/4 beat
+        int len = 120 >> ( ( trk / 8 ) % 3 );
+        MIDITimedBigMessage msg;
+
+        for ( MIDIClockTime time = 0; time < ( MIDIClockTime ) num_beats * 120; time += len )
+        {
+            // rests
+            if ( rand() % 8 == 0 )
+                continue;
+
+            msg.SetTime ( time );
+            msg.SetNoteOn ( chan, note, 100 );
+            t->PutEvent ( msg );
+            msg.SetTime ( time + len );
+            msg.SetNoteOff ( chan, note, 0 );
+            t->PutEvent ( msg );
+        }
+
+        msg.SetTime ( num_beats * 120 );
+        msg.SetDataEnd();
+        t->PutEvent ( msg );
+    }
+}
+
+static bool LoadMidiFile ( MIDIMultiTrack &tracks, const char *file_name )
+{
+    MIDIFileReadStreamFile rs ( file_name );
+
+    if ( !rs.IsValid() )
+        return false;
+
+    MIDIFileReadMultiTrack track_loader ( &tracks );
+    MIDIFileRead reader ( &rs, &track_loader );
+    tracks.ClearAndResize ( reader.ReadNumTracks() );
+    return reader.Parse();
+}
+
+template <class T> unsigned long BenchIterate ( T &it, int passes, double *sec, long *num_events )
+{
+    unsigned long sum = 0;
+    clock_t start = clock();
+    *num_events = 0;
+
+    for ( int p = 0; p < passes; ++p )
+    {
+        int trk;
+        const MIDITimedBigMessage *msg;
+        it.GoToZero();
+
+        while ( it.GetCurEvent ( &trk, &msg ) )
+        {
+            // order sensitive checksum of the visited events
+            sum = sum * 31 + trk + msg->GetTime();
+            ++*num_events;
+
+            if ( !it.GoToNextEvent() )
+                break;
+        }
+    }
+
+    *sec = Seconds ( start );
+    return sum;
+}
+
+class TreeIterator : public MIDIMultiTrackIterator
+{
+public:
+    TreeIterator ( const MIDIMultiTrack *mlt ) : MIDIMultiTrackIterator ( mlt )
+    {
+    }
+
+    void GoToZero()
+    {
+        GoToTime ( 0 );
+    }
+};
+
+static void Report ( const char *what, double events, double sec )
+{
+    if ( sec <= 0. )
+        sec = 1e-9;
+
+    fprintf ( stdout, "  %-28s %10.2f M events/s\n", what, events / sec * 1e-6 );
+}
+
+int main ( int argc, char **argv )
+{
+    MIDIMultiTrack tracks;
+    int passes = 5;
+
+    if ( argc > 2 )
+        passes = atoi ( argv[2] );
+
+    if ( argc > 1 && atoi ( argv[1] ) == 0 )
+    {
+        if ( !LoadMidiFile ( tracks, argv[1] ) )
+        {
+            fprintf ( stderr, "Error reading file %s\n", argv[1] );
+            return 1;
+        }
+
+        fprintf ( stdout, "%s: %d tracks, %d events, %d passes\n",
+                  argv[1], tracks.GetNumTracks(), tracks.GetNumEvents(), passes );
+    }
+    else
+    {
+        int num_tracks = ( argc > 1 ) ? atoi ( argv[1] ) : 96;
+        MakeOrchestra ( tracks, num_tracks, 2000 );
+        fprintf ( stdout, "synthetic orchestra: %d tracks, %d events, %d passes\n",
+                  tracks.GetNumTracks(), tracks.GetNumEvents(), passes );
+    }
+
+    double sec;
+    long num1, num2;
+    unsigned long sum1, sum2;
+
+    {
+        LinearScanIterator it ( &tracks );
+        sum1 = BenchIterate ( it, passes, &sec, &num1 );
+        Report ( "linear scan of tracks", num1, sec );
+    }
+
+    {
+        TreeIterator it ( &tracks );
+        sum2 = BenchIterate ( it, passes, &sec, &num2 );
+        Report ( "MIDIMultiTrackIterator", num2, sec );
+    }
+
+    if ( num1 != num2 || sum1 != sum2 )
+    {
+        fprintf ( stdout, "event order differs (%ld events, %ld events)\n", num1, num2 );
+        return 1;
+    }
+
+    return 0;
+}
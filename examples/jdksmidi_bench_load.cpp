@@ -0,0 +1,207 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+//
+// Compare the wall clock time of loading a midifile into a multitrack with
+// the serial MIDIFileRead, with and without presized tracks, and with
+// MIDIFileReadMultiTrackParallel, on the given midifiles, or on a synthetic
+// orchestral file with 100 tracks.
+//
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/multitrack.h"
+#include "jdksmidi/filewrite.h"
+#include "jdksmidi/utils.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace jdksmidi;
+
+static double Seconds ( std::chrono::steady_clock::time_point start )
+{
+    return std::chrono::duration<double> ( std::chrono::steady_clock::now() - start ).count();
+}
+
+// tracks of notes and controllers with a lyric every 64 events
+static bool WriteSyntheticFile ( const char *fname, int num_tracks, int events_per_track )
+{
+    MIDIFileWriteStreamFileName out ( fname );
+
+    if ( !out.IsValid() )
+        return false;
+
+    MIDIFileWrite writer ( &out );
+    writer.WriteFileHeader ( 1, num_tracks, 480 );
+
+    for ( int trk = 0; trk < num_tracks; ++trk )
+    {
+        MIDITimedBigMessage msg;
+        MIDIClockTime time = 0;
+        unsigned char chan = ( unsigned char ) ( trk % 16 );
+
+        writer.WriteTrackHeader ( 0 );
+
+        for ( int i = 0; i < events_per_track; ++i )
+        {
+            time += ( i & 1 ) ? 0 : 60;
+            msg.SetTime ( time );
+
+            if ( i % 64 == 63 )
+            {
+                writer.WriteTextEvent ( time, META_LYRIC_TEXT, "synthetic lyric text" );
+                continue;
+            }
+
+            if ( i % 8 == 7 )
+                msg.SetControlChange ( chan, 7, ( unsigned char ) ( i & 0x7f ) );
+            else
+                msg.SetNoteOn ( chan, ( unsigned char ) ( 36 + i % 48 ), ( unsigned char ) ( ( i & 2 ) ? 0 : 100 ) );
+
+            writer.WriteEvent ( msg );
+        }
+
+        writer.WriteEndOfTrack ( time );
+        writer.RewriteTrackLength();
+    }
+
+    return writer.Flush();
+}
+
+static bool SameMultiTrack ( const MIDIMultiTrack &m1, const MIDIMultiTrack &m2 )
+{
+    if ( m1.GetNumTracks() != m2.GetNumTracks() || m1.GetClksPerBeat() != m2.GetClksPerBeat() )
+        return false;
+
+    for ( int trk = 0; trk < m1.GetNumTracks(); ++trk )
+    {
+        const MIDITrack *t1 = m1.GetTrack ( trk );
+        const MIDITrack *t2 = m2.GetTrack ( trk );
+
+        if ( t1->GetNumEvents() != t2->GetNumEvents() )
+            return false;
+
+        for ( int i = 0; i < t1->GetNumEvents(); ++i )
+        {
+            if ( !( *t1->GetEventAddress ( i ) == *t2->GetEventAddress ( i ) ) )
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool BenchFile ( const char *fname, int passes )
+{
+    fprintf ( stdout, "%s: %d passes\n", fname, passes );
+
+    MIDIMultiTrack serial;
+    double sec = 0.;
+
+    for ( int p = 0; p < passes; ++p )
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if ( !ReadMidiFile ( fname, serial ) )
+        {
+            fprintf ( stderr, "Error reading file %s\n", fname );
+            return false;
+        }
+
+        sec += Seconds ( start );
+    }
+
+    fprintf ( stdout, "  %-24s %8.2f ms  %d tracks, %d events\n", "serial MIDIFileRead",
+              sec / passes * 1e3, serial.GetNumTracks(), serial.GetNumEvents() );
+
+    bool ok = true;
+
+    {
+        MIDIMultiTrack presized;
+        sec = 0.;
+
+        for ( int p = 0; p < passes; ++p )
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ReadMidiFile ( fname, presized, true );
+            sec += Seconds ( start );
+        }
+
+        bool same = SameMultiTrack ( serial, presized );
+        fprintf ( stdout, "  %-24s %8.2f ms  %s\n", "serial, presized tracks", sec / passes * 1e3, same ? "same tracks" : "TRACKS DIFFER" );
+        ok = ok && same;
+    }
+
+    int hw = ( int ) std::thread::hardware_concurrency();
+
+    for ( int threads = 1; threads <= ( hw > 4 ? hw : 4 ); threads *= 2 )
+    {
+        MIDIMultiTrack parallel;
+        sec = 0.;
+
+        for ( int p = 0; p < passes; ++p )
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ReadMidiFileParallel ( fname, parallel, threads );
+            sec += Seconds ( start );
+        }
+
+        bool same = SameMultiTrack ( serial, parallel );
+        char what[64];
+        sprintf ( what, "parallel, %d threads", threads );
+        fprintf ( stdout, "  %-24s %8.2f ms  %s\n", what, sec / passes * 1e3, same ? "same tracks" : "TRACKS DIFFER" );
+        ok = ok && same;
+    }
+
+    return ok;
+}
+
+int main ( int argc, char **argv )
+{
+    bool ok = true;
+
+    fprintf ( stdout, "hardware threads %u\n", std::thread::hardware_concurrency() );
+
+    if ( argc > 1 )
+    {
+        for ( int i = 1; i < argc; ++i )
+            ok = BenchFile ( argv[i], 20 ) && ok;
+    }
+    else
+    {
+        const char *fname = "jdksmidi_bench_load.mid";
+
+        if ( !WriteSyntheticFile ( fname, 100, 20000 ) )
+        {
+            fprintf ( stderr, "Error writing file %s\n", fname );
+            return 1;
+        }
+
+        ok = BenchFile ( fname, 3 );
+        remove ( fname );
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,457 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+//
+// Stress test and benchmark of MIDIQueue between two threads: a producer puts a stream
+// of channel messages and sysex of several lengths, a consumer checks that every message
+// arrives once, in order and intact, and measures the throughput and the latency from
+// Put() to the consumer seeing the message. Memory allocations during the transfer are
+// counted, there must be none.
+// Then the same through a MIDIDriver with thru enabled: a sequencer thread outputs messages
+// while a midi in thread feeds others to HardwareMsgIn(), and a timer thread calls
+// TimeTick() and reads the in queue, checking both streams arrive once, in order and intact.
+//
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/queue.h"
+#include "jdksmidi/driver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+using namespace jdksmidi;
+
+typedef std::chrono::steady_clock Clock;
+
+// count the allocations of each thread, to check the transfer makes none; the whole set of
+// replaceable operators is replaced so that every new and delete goes through malloc and free
+static thread_local long num_allocations = 0;
+
+static void *CountedAlloc ( size_t size )
+{
+    ++num_allocations;
+    return malloc ( size ? size : 1 );
+}
+
+void *operator new ( size_t size )
+{
+    void *p = CountedAlloc ( size );
+
+    if ( !p )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new[] ( size_t size )
+{
+    return operator new ( size );
+}
+
+void *operator new ( size_t size, const std::nothrow_t & ) noexcept
+{
+    return CountedAlloc ( size );
+}
+
+void *operator new[] ( size_t size, const std::nothrow_t & ) noexcept
+{
+    return CountedAlloc ( size );
+}
+
+void operator delete ( void *p ) noexcept
+{
+    free ( p );
+}
+
+void operator delete[] ( void *p ) noexcept
+{
+    free ( p );
+}
+
+void operator delete ( void *p, size_t ) noexcept
+{
+    free ( p );
+}
+
+void operator delete[] ( void *p, size_t ) noexcept
+{
+    free ( p );
+}
+
+void operator delete ( void *p, const std::nothrow_t & ) noexcept
+{
+    free ( p );
+}
+
+void operator delete[] ( void *p, const std::nothrow_t & ) noexcept
+{
+    free ( p );
+}
+
+class Transfer
+{
+public:
+    Transfer ( int queue_size, int num_msgs_ )
+        : queue ( queue_size ), num_msgs ( num_msgs_ ), put_time ( num_msgs_ ),
+          latency ( num_msgs_ ), errors ( 0 ), ready ( 0 ), allocations ( 0 )
+    {
+    }
+
+    MIDIQueue queue;
+    int num_msgs;
+    std::vector< Clock::time_point > put_time; // of message i, written by the producer
+    std::vector< double > latency;              // of message i in microseconds
+    std::atomic<int> errors;
+    std::atomic<int> ready;                     // threads ready to start
+    std::atomic<long> allocations;              // during the transfer
+};
+
+// payload length of message i: mostly none, some inline, some in the payload slots
+static int PayloadLength ( int i )
+{
+    if ( i % 16 == 0 )
+        return 1 + i % MIDIQueue::DEFAULT_MAX_PAYLOAD;
+
+    if ( i % 4 == 0 )
+        return 1 + i % MIDISystemExclusive::INLINE_SIZE;
+
+    return 0;
+}
+
+static void MakeMessage ( MIDITimedBigMessage &msg, MIDISystemExclusive &sysex, int i )
+{
+    int len = PayloadLength ( i );
+
+    if ( len == 0 )
+    {
+        msg.SetNoteOn ( ( unsigned char ) ( i & 0xf ), ( unsigned char ) ( i & 0x7f ), 100 );
+        msg.ClearSysEx();
+    }
+
+    else
+    {
+        sysex.Clear();
+
+        for ( int k = 0; k < len; ++k )
+            sysex.PutByte ( ( unsigned char ) ( i + k ) );
+
+        msg.SetSysEx ( SYSEX_START_N );
+        msg.CopySysEx ( &sysex );
+    }
+
+    // the time is the sequence number
+    msg.SetTime ( i );
+}
+
+static bool CheckMessage ( const MIDITimedBigMessage &msg, int i )
+{
+    if ( msg.GetTime() != ( MIDIClockTime ) i )
+        return false;
+
+    int len = PayloadLength ( i );
+    const MIDISystemExclusive *sysex = msg.GetSysEx();
+
+    if ( len == 0 )
+        return !sysex && msg.IsNoteOn() && msg.GetNote() == ( i & 0x7f );
+
+    if ( !sysex || sysex->GetLengthSE() != len )
+        return false;
+
+    for ( int k = 0; k < len; ++k )
+    {
+        if ( sysex->GetData ( k ) != ( unsigned char ) ( i + k ) )
+            return false;
+    }
+
+    return true;
+}
+
+static void WaitForStart ( std::atomic<int> *ready, int num_threads )
+{
+    ++*ready;
+
+    while ( ready->load() < num_threads )
+        std::this_thread::yield();
+}
+
+static void Producer ( Transfer *t )
+{
+    // the messages are made before the start, MakeMessage() may allocate
+    std::vector< MIDITimedBigMessage > msgs ( 64 );
+    MIDISystemExclusive sysex ( MIDIQueue::DEFAULT_MAX_PAYLOAD );
+    int num_made = ( int ) msgs.size();
+
+    WaitForStart ( &t->ready, 2 );
+    long allocations = num_allocations;
+
+    for ( int i = 0; i < t->num_msgs; ++i )
+    {
+        // refill the ring of prepared messages while the queue is not full
+        MIDITimedBigMessage &msg = msgs[i % num_made];
+
+        if ( i % num_made == 0 )
+        {
+            long before = num_allocations;
+
+            for ( int n = 0; n < num_made && i + n < t->num_msgs; ++n )
+                MakeMessage ( msgs[n], sysex, i + n );
+
+            // preparing the messages is not part of the transfer
+            allocations += num_allocations - before;
+        }
+
+        while ( !t->queue.CanPut() )
+            std::this_thread::yield();
+
+        t->put_time[i] = Clock::now();
+
+        if ( !t->queue.Put ( msg ) )
+            ++t->errors;
+    }
+
+    t->allocations += num_allocations - allocations;
+}
+
+static void Consumer ( Transfer *t )
+{
+    WaitForStart ( &t->ready, 2 );
+    long allocations = num_allocations;
+
+    for ( int i = 0; i < t->num_msgs; ++i )
+    {
+        while ( !t->queue.CanGet() )
+            std::this_thread::yield();
+
+        Clock::time_point now = Clock::now();
+        const MIDITimedBigMessage &msg = t->queue.Get();
+
+        if ( !CheckMessage ( msg, i ) )
+            ++t->errors;
+
+        t->latency[i] = std::chrono::duration<double, std::micro> ( now - t->put_time[i] ).count();
+        t->queue.Next();
+    }
+
+    t->allocations += num_allocations - allocations;
+}
+
+// a driver whose hardware checks the messages it gets: message k of the sequencer
+// thread is made by MakeMessage() with number 2 * k, message k of the midi in thread
+// with number 2 * k + 1, so the time tells the source
+class CheckingDriver : public MIDIDriver
+{
+public:
+    CheckingDriver ( int queue_size ) : MIDIDriver ( queue_size ), errors ( 0 )
+    {
+        num_sent[0] = num_sent[1] = 0;
+        SetThruEnable ( true );
+    }
+
+    virtual bool HardwareMsgOut ( const MIDITimedBigMessage &msg )
+    {
+        int source = ( int ) ( msg.GetTime() & 1 );
+
+        if ( !CheckMessage ( msg, 2 * num_sent[source] + source ) )
+            ++errors;
+
+        ++num_sent[source];
+        return true;
+    }
+
+    // used by the timer thread only
+    int num_sent[2];
+    int errors;
+};
+
+class DriverTransfer
+{
+public:
+    DriverTransfer ( int queue_size, int num_msgs_ )
+        : driver ( queue_size ), num_msgs ( num_msgs_ ), errors ( 0 ), ready ( 0 ), allocations ( 0 )
+    {
+    }
+
+    CheckingDriver driver;
+    int num_msgs;                               // of each producer
+    std::atomic<int> errors;
+    std::atomic<int> ready;                     // threads ready to start
+    std::atomic<long> allocations;              // during the transfer
+};
+
+// source 0 is the sequencer thread, source 1 the midi in thread
+static void DriverProducer ( DriverTransfer *t, int source )
+{
+    std::vector< MIDITimedBigMessage > msgs ( 64 );
+    MIDISystemExclusive sysex ( MIDIQueue::DEFAULT_MAX_PAYLOAD );
+    int num_made = ( int ) msgs.size();
+
+    WaitForStart ( &t->ready, 3 );
+    long allocations = num_allocations;
+
+    for ( int i = 0; i < t->num_msgs; ++i )
+    {
+        MIDITimedBigMessage &msg = msgs[i % num_made];
+
+        if ( i % num_made == 0 )
+        {
+            long before = num_allocations;
+
+            for ( int n = 0; n < num_made && i + n < t->num_msgs; ++n )
+                MakeMessage ( msgs[n], sysex, 2 * ( i + n ) + source );
+
+            allocations += num_allocations - before;
+        }
+
+        if ( source == 0 )
+        {
+            while ( !t->driver.CanOutputMessage() )
+                std::this_thread::yield();
+
+            if ( !t->driver.OutputMessage ( msg ) )
+                ++t->errors;
+        }
+
+        else
+        {
+            // each message goes to the in queue and to the thru queue
+            while ( !t->driver.InputQueue()->CanPut() || !t->driver.ThruQueue()->CanPut() )
+                std::this_thread::yield();
+
+            if ( !t->driver.HardwareMsgIn ( msg ) )
+                ++t->errors;
+        }
+    }
+
+    t->allocations += num_allocations - allocations;
+}
+
+// the timer thread sends the out and thru messages, and the application reads the in queue
+static void DriverConsumer ( DriverTransfer *t )
+{
+    WaitForStart ( &t->ready, 3 );
+    long allocations = num_allocations;
+    MIDIQueue *in = t->driver.InputQueue();
+    int num_in = 0;
+
+    while ( t->driver.num_sent[0] < t->num_msgs || t->driver.num_sent[1] < t->num_msgs ||
+            num_in < t->num_msgs )
+    {
+        t->driver.TimeTick ( 0 );
+
+        while ( in->CanGet() )
+        {
+            if ( !CheckMessage ( in->Get(), 2 * num_in + 1 ) )
+                ++t->errors;
+
+            ++num_in;
+            in->Next();
+        }
+
+        std::this_thread::yield();
+    }
+
+    t->errors += t->driver.errors;
+    t->allocations += num_allocations - allocations;
+}
+
+static bool RunDriver ( int queue_size, int num_msgs )
+{
+    DriverTransfer transfer ( queue_size, num_msgs );
+    DriverTransfer *t = &transfer;
+
+    Clock::time_point start = Clock::now();
+    std::thread timer ( DriverConsumer, t );
+    std::thread sequencer ( DriverProducer, t, 0 );
+    std::thread midi_in ( DriverProducer, t, 1 );
+    sequencer.join();
+    midi_in.join();
+    timer.join();
+    double sec = std::chrono::duration<double> ( Clock::now() - start ).count();
+
+    fprintf ( stdout, "driver with thru, %d output and %d input messages\n", num_msgs, num_msgs );
+    fprintf ( stdout, "  throughput     %10.2f M messages/s\n", 2 * num_msgs / sec * 1e-6 );
+    fprintf ( stdout, "  allocations    %10ld\n", t->allocations.load() );
+    fprintf ( stdout, "  dropped        %10lu\n", t->driver.GetNumDroppedMessages() );
+    fprintf ( stdout, "  errors         %10d\n", t->errors.load() );
+
+    return t->errors == 0 && t->allocations == 0 && t->driver.GetNumDroppedMessages() == 0;
+}
+
+static double Percentile ( const std::vector< double > &sorted, double p )
+{
+    size_t i = ( size_t ) ( p * ( sorted.size() - 1 ) );
+    return sorted[i];
+}
+
+int main ( int argc, char **argv )
+{
+    int num_msgs = 1000000;
+    int queue_size = 256;
+
+    if ( argc > 1 )
+        num_msgs = atoi ( argv[1] );
+
+    if ( argc > 2 )
+        queue_size = atoi ( argv[2] );
+
+    if ( num_msgs < 1 || queue_size < 2 )
+    {
+        fprintf ( stderr, "usage: %s [num_msgs] [queue_size]\n", argv[0] );
+        return 1;
+    }
+
+    fprintf ( stdout, "messages %d, queue size %d, payload slots of %d bytes\n",
+              num_msgs, queue_size, MIDIQueue::DEFAULT_MAX_PAYLOAD );
+
+    Transfer transfer ( queue_size, num_msgs );
+    Transfer *t = &transfer;
+
+    Clock::time_point start = Clock::now();
+    std::thread consumer ( Consumer, t );
+    std::thread producer ( Producer, t );
+    producer.join();
+    consumer.join();
+    double sec = std::chrono::duration<double> ( Clock::now() - start ).count();
+
+    std::vector< double > sorted ( t->latency );
+    std::sort ( sorted.begin(), sorted.end() );
+
+    fprintf ( stdout, "  throughput     %10.2f M messages/s\n", num_msgs / sec * 1e-6 );
+    fprintf ( stdout, "  latency p50    %10.2f us\n", Percentile ( sorted, 0.5 ) );
+    fprintf ( stdout, "  latency p99    %10.2f us\n", Percentile ( sorted, 0.99 ) );
+    fprintf ( stdout, "  latency p99.9  %10.2f us\n", Percentile ( sorted, 0.999 ) );
+    fprintf ( stdout, "  latency max    %10.2f us\n", sorted.back() );
+    fprintf ( stdout, "  allocations    %10ld\n", t->allocations.load() );
+    fprintf ( stdout, "  errors         %10d\n", t->errors.load() );
+
+    bool ok = ( t->errors == 0 && t->allocations == 0 );
+
+    if ( !RunDriver ( queue_size, num_msgs / 2 ) )
+        ok = false;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+//
+// Measure the midifile parse throughput of MIDIFileRead with the block
+// buffered file stream, the memory stream, the mapped file stream and a per
+// byte stream like the former MIDIFileReadStreamFile, on the given midifiles,
+// or on a large synthetic midifile.
+//
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/fileread.h"
+#include "jdksmidi/filewrite.h"
+
+#include <time.h>
+
+using namespace jdksmidi;
+
+// replica of the former MIDIFileReadStreamFile, kept here for comparison only
+class PerByteStream : public MIDIFileReadStream
+{
+public:
+    explicit PerByteStream ( const char *fname )
+    {
+        f = fopen ( fname, "rb" );
+    }
+
+    virtual ~PerByteStream()
+    {
+        if ( f ) fclose ( f );
+    }
+
+    virtual void Rewind()
+    {
+        if ( f ) rewind ( f );
+    }
+
+    virtual int ReadChar()
+    {
+        int r = -1;
+
+        if ( f && !feof ( f ) && !ferror ( f ) )
+        {
+            r = fgetc ( f );
+        }
+
+        return r;
+    }
+
+private:
+    FILE *f;
+};
+
+// counts the events, so the parser output can be compared
+class CountEvents : public MIDIFileEvents
+{
+public:
+    CountEvents() : num_events ( 0 )
+    {
+    }
+
+    virtual bool ChanMessage ( const MIDITimedMessage &msg )
+    {
+        ++num_events;
+        return true;
+    }
+
+    virtual bool MetaEvent ( MIDIClockTime time, int type, int len, unsigned char *buf )
+    {
+        ++num_events;
+        return true;
+    }
+
+    virtual bool mf_sysex ( MIDIClockTime time, int type, int len, unsigned char *s )
+    {
+        ++num_events;
+        return true;
+    }
+
+    long num_events;
+};
+
+static double Seconds ( clock_t start )
+{
+    return double ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+// tracks of notes and controllers with a lyric every 64 events
+static bool WriteSyntheticFile ( const char *fname, int num_tracks, int events_per_track )
+{
+    MIDIFileWriteStreamFileName out ( fname );
+
+    if ( !out.IsValid() )
+        return false;
+
+    MIDIFileWrite writer ( &out );
+    writer.WriteFileHeader ( 1, num_tracks, 480 );
+
+    for ( int trk = 0; trk < num_tracks; ++trk )
+    {
+        MIDITimedBigMessage msg;
+        MIDIClockTime time = 0;
+        unsigned char chan = ( unsigned char ) ( trk % 16 );
+
+        writer.WriteTrackHeader ( 0 );
+
+        for ( int i = 0; i < events_per_track; ++i )
+        {
+            time += ( i & 1 ) ? 0 : 60;
+            msg.SetTime ( time );
+
+            if ( i % 64 == 63 )
+            {
+                writer.WriteTextEvent ( time, META_LYRIC_TEXT, "synthetic lyric text" );
+                continue;
+            }
+
+            if ( i % 8 == 7 )
+                msg.SetControlChange ( chan, 7, ( unsigned char ) ( i & 0x7f ) );
+            else
+                msg.SetNoteOn ( chan, ( unsigned char ) ( 36 + i % 48 ), ( unsigned char ) ( ( i & 2 ) ? 0 : 100 ) );
+
+            writer.WriteEvent ( msg );
+        }
+
+        writer.WriteEndOfTrack ( time );
+        writer.RewriteTrackLength();
+    }
+
+    return writer.Flush();
+}
+
+static long ParseOnce ( MIDIFileReadStream *stream, double *sec )
+{
+    CountEvents events;
+    MIDIFileRead reader ( stream, &events );
+    clock_t start = clock();
+    bool ok = reader.Parse();
+    *sec = Seconds ( start );
+    return ok ? events.num_events : -1;
+}
+
+static void Report ( const char *what, double bytes, long num_events, double sec )
+{
+    if ( sec <= 0. )
+        sec = 1e-9;
+
+    fprintf ( stdout, "  %-28s %8.1f MB/s  %ld events\n", what, bytes / sec * 1e-6, num_events );
+}
+
+static bool BenchFile ( const char *fname, int passes )
+{
+    FILE *f = fopen ( fname, "rb" );
+
+    if ( !f )
+    {
+        fprintf ( stderr, "Error opening file %s\n", fname );
+        return false;
+    }
+
+    std::vector< unsigned char > data;
+    unsigned char block[4096];
+    size_t n;
+
+    while ( ( n = fread ( block, 1, sizeof ( block ), f ) ) > 0 )
+        data.insert ( data.end(), block, block + n );
+
+    fclose ( f );
+
+    fprintf ( stdout, "%s: %lu bytes, %d passes\n", fname, ( unsigned long ) data.size(), passes );
+
+    double bytes = double ( data.size() ) * passes;
+    double sec, total;
+    long num1 = 0, num2 = 0, num3 = 0, num4 = 0;
+    int p;
+
+    for ( p = 0, total = 0.; p < passes; ++p )
+    {
+        PerByteStream rs ( fname );
+        num1 = ParseOnce ( &rs, &sec );
+        total += sec;
+    }
+
+    Report ( "per byte stream (former)", bytes, num1, total );
+
+    for ( p = 0, total = 0.; p < passes; ++p )
+    {
+        MIDIFileReadStreamFile rs ( fname );
+        num2 = ParseOnce ( &rs, &sec );
+        total += sec;
+    }
+
+    Report ( "MIDIFileReadStreamFile", bytes, num2, total );
+
+    for ( p = 0, total = 0.; p < passes; ++p )
+    {
+        MIDIFileReadStreamMemory rs ( data.empty() ? 0 : &data[0], ( unsigned long ) data.size() );
+        num3 = ParseOnce ( &rs, &sec );
+        total += sec;
+    }
+
+    Report ( "MIDIFileReadStreamMemory", bytes, num3, total );
+
+    for ( p = 0, total = 0.; p < passes; ++p )
+    {
+        // the mapping is part of the cost
+        clock_t start = clock();
+        MIDIFileReadStreamMapped rs ( fname );
+        num4 = ParseOnce ( &rs, &sec );
+        total += Seconds ( start );
+    }
+
+    Report ( "MIDIFileReadStreamMapped", bytes, num4, total );
+
+    if ( num1 != num2 || num1 != num3 || num1 != num4 )
+    {
+        fprintf ( stdout, "  parse results differ\n" );
+        return false;
+    }
+
+    return true;
+}
+
+int main ( int argc, char **argv )
+{
+    bool ok = true;
+
+    if ( argc > 1 )
+    {
+        // small files need many passes for a measurable time
+        for ( int i = 1; i < argc; ++i )
+            ok = BenchFile ( argv[i], 200 ) && ok;
+    }
+    else
+    {
+        const char *fname = "jdksmidi_bench_read.mid";
+
+        if ( !WriteSyntheticFile ( fname, 16, 250000 ) )
+        {
+            fprintf ( stderr, "Error writing file %s\n", fname );
+            return 1;
+        }
+
+        ok = BenchFile ( fname, 3 );
+        remove ( fname );
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+//
+// Compare append and sequential scan throughput of MIDITrack against the
+// old chunked track layout (512 chunks of 512 events, one divide, one modulo
+// and one pointer hop per event access).
+//
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/track.h"
+
+#include <time.h>
+
+using namespace jdksmidi;
+
+// replica of the former MIDITrack storage, kept here for comparison only
+class ChunkedTrack
+{
+public:
+    enum { CHUNK_SIZE = 512, CHUNKS_PER_TRACK = 512 };
+
+    ChunkedTrack() : buf_size ( 0 ), num_events ( 0 )
+    {
+        for ( int i = 0; i < CHUNKS_PER_TRACK; ++i )
+            chunk[i] = 0;
+    }
+
+    ~ChunkedTrack()
+    {
+        for ( int i = 0; i < buf_size / CHUNK_SIZE; ++i )
+            delete chunk[i];
+    }
+
+    bool PutEvent ( const MIDITimedBigMessage &msg )
+    {
+        if ( num_events >= buf_size )
+        {
+            int n = buf_size / CHUNK_SIZE;
+
+            if ( n + 1 >= CHUNKS_PER_TRACK )
+                return false;
+
+            chunk[n] = new Chunk;
+            buf_size += CHUNK_SIZE;
+        }
+
+        GetEventAddress ( num_events++ )->Copy ( msg );
+        return true;
+    }
+
+    const MIDITimedBigMessage *GetEventAddress ( int event_num ) const
+    {
+        return &chunk[ event_num / CHUNK_SIZE ]->buf[ event_num % CHUNK_SIZE ];
+    }
+
+    MIDITimedBigMessage *GetEventAddress ( int event_num )
+    {
+        return &chunk[ event_num / CHUNK_SIZE ]->buf[ event_num % CHUNK_SIZE ];
+    }
+
+    int GetNumEvents() const
+    {
+        return num_events;
+    }
+
+private:
+    struct Chunk
+    {
+        MIDITimedBigMessage buf[CHUNK_SIZE];
+    };
+
+    Chunk *chunk[CHUNKS_PER_TRACK];
+    int buf_size;
+    int num_events;
+};
+
+static double Seconds ( clock_t start )
+{
+    return double ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+static void MakeEvent ( MIDITimedBigMessage &msg, int i )
+{
+    msg.SetControlChange ( ( unsigned char ) ( i & 0xf ), 7, ( unsigned char ) ( i & 0x7f ) );
+    msg.SetTime ( i );
+}
+
+template <class T> void BenchAppend ( T &trk, int num_events, double *sec )
+{
+    MIDITimedBigMessage msg;
+    clock_t start = clock();
+
+    for ( int i = 0; i < num_events; ++i )
+    {
+        MakeEvent ( msg, i );
+
+        if ( !trk.PutEvent ( msg ) )
+        {
+            fprintf ( stdout, "  PutEvent failed at event %d\n", i );
+            break;
+        }
+    }
+
+    *sec = Seconds ( start );
+}
+
+template <class T> unsigned long BenchScan ( const T &trk, int passes, double *sec )
+{
+    unsigned long sum = 0;
+    clock_t start = clock();
+
+    for ( int p = 0; p < passes; ++p )
+    {
+        int n = trk.GetNumEvents();
+
+        for ( int i = 0; i < n; ++i )
+        {
+            const MIDITimedBigMessage *msg = trk.GetEventAddress ( i );
+            sum += msg->GetTime() + msg->GetControllerValue();
+        }
+    }
+
+    *sec = Seconds ( start );
+    return sum;
+}
+
+static void Report ( const char *what, double events, double sec )
+{
+    if ( sec <= 0. )
+        sec = 1e-9;
+
+    fprintf ( stdout, "  %-28s %10.2f M events/s\n", what, events / sec * 1e-6 );
+}
+
+int main ( int argc, char **argv )
+{
+    // stay below the 262144 events limit of the chunked layout
+    int num_events = 250000;
+    int passes = 20;
+
+    if ( argc > 1 )
+        num_events = atoi ( argv[1] );
+
+    if ( argc > 2 )
+        passes = atoi ( argv[2] );
+
+    fprintf ( stdout, "events per track %d, scan passes %d\n", num_events, passes );
+
+    double sec;
+    unsigned long sum1, sum2;
+    int num1, num2;
+
+    {
+        ChunkedTrack *trk = new ChunkedTrack;
+        fprintf ( stdout, "chunked layout:\n" );
+        BenchAppend ( *trk, num_events, &sec );
+        Report ( "append", trk->GetNumEvents(), sec );
+        sum1 = BenchScan ( *trk, passes, &sec );
+        Report ( "sequential scan", double ( trk->GetNumEvents() ) * passes, sec );
+        num1 = trk->GetNumEvents();
+        delete trk;
+    }
+
+    {
+        MIDITrack *trk = new MIDITrack;
+        fprintf ( stdout, "contiguous MIDITrack:\n" );
+        BenchAppend ( *trk, num_events, &sec );
+        Report ( "append", trk->GetNumEvents(), sec );
+        sum2 = BenchScan ( *trk, passes, &sec );
+        Report ( "sequential scan", double ( trk->GetNumEvents() ) * passes, sec );
+        num2 = trk->GetNumEvents();
+        delete trk;
+    }
+
+    if ( num1 != num2 )
+    {
+        fprintf ( stdout, "chunked layout stored only %d of %d events\n", num1, num2 );
+        return 0;
+    }
+
+    if ( sum1 != sum2 )
+        fprintf ( stdout, "scan results differ (%lu != %lu)\n", sum1, sum2 );
+
+    return ( sum1 == sum2 ) ? 0 : 1;
+}
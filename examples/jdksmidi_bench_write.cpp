@@ -0,0 +1,313 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+//
+// Measure midifile write throughput in MB/s: the buffered writer on a file and on a
+// memory stream, against a stream that only implements WriteChar() (one fputc per byte,
+// as every stream was driven before the writer buffered its output), and the tracks
+// encoded by several threads. Then the time to the first byte written to a seekable
+// stream and to a stream written strictly forward, like a pipe, which must get the
+// same bytes.
+//
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/multitrack.h"
+#include "jdksmidi/filewrite.h"
+#include "jdksmidi/filewritemultitrack.h"
+
+#include <chrono>
+
+using namespace jdksmidi;
+
+// a file stream without WriteBlock(), so every byte costs one virtual call and one fputc
+class ByteFileStream : public MIDIFileWriteStream
+{
+public:
+    ByteFileStream ( const char *fname ) : f ( fopen ( fname, "wb" ) )
+    {
+    }
+
+    virtual ~ByteFileStream()
+    {
+        if ( f )
+            fclose ( f );
+    }
+
+    bool IsValid() const
+    {
+        return f != 0;
+    }
+
+    long Seek ( long pos, int whence = SEEK_SET )
+    {
+        return fseek ( f, pos, whence );
+    }
+
+    int WriteChar ( int c )
+    {
+        return ( fputc ( c, f ) == EOF ) ? -1 : 0;
+    }
+
+private:
+    FILE *f;
+};
+
+// a memory stream which notes when the first byte arrives, seekable or not like a pipe
+class TimedMemoryStream : public MIDIFileWriteStreamMemory
+{
+public:
+    TimedMemoryStream ( bool seekable_ ) : seekable ( seekable_ ), written ( false )
+    {
+    }
+
+    long Seek ( long pos, int whence = SEEK_SET )
+    {
+        return seekable ? MIDIFileWriteStreamMemory::Seek ( pos, whence ) : -1;
+    }
+
+    int WriteChar ( int c )
+    {
+        Written();
+        return MIDIFileWriteStreamMemory::WriteChar ( c );
+    }
+
+    int WriteBlock ( const unsigned char *data, int len )
+    {
+        Written();
+        return MIDIFileWriteStreamMemory::WriteBlock ( data, len );
+    }
+
+    bool IsSeekable()
+    {
+        return seekable;
+    }
+
+    std::chrono::steady_clock::time_point first_byte_time;
+
+private:
+    void Written()
+    {
+        if ( !written )
+        {
+            first_byte_time = std::chrono::steady_clock::now();
+            written = true;
+        }
+    }
+
+    bool seekable;
+    bool written;
+};
+
+static void MakeMultiTrack ( MIDIMultiTrack &mt, int num_tracks, int events_per_track )
+{
+    mt.ClearAndResize ( num_tracks );
+    mt.SetClksPerBeat ( 480 );
+
+    MIDITimedBigMessage msg;
+
+    for ( int t = 0; t < num_tracks; ++t )
+    {
+        MIDITrack *trk = mt.GetTrack ( t );
+        unsigned char chan = ( unsigned char ) ( t & 0xf );
+
+        for ( int i = 0; i < events_per_track; i += 2 )
+        {
+            unsigned char note = ( unsigned char ) ( 36 + ( i * 7 + t ) % 60 );
+            msg.SetNoteOn ( chan, note, 100 );
+            msg.SetTime ( i * 60 );
+            trk->PutEvent ( msg );
+            msg.SetNoteOff ( chan, note, 0 );
+            msg.SetTime ( i * 60 + 50 );
+            trk->PutEvent ( msg );
+        }
+    }
+}
+
+static double Seconds ( std::chrono::steady_clock::time_point start )
+{
+    return std::chrono::duration<double> ( std::chrono::steady_clock::now() - start ).count();
+}
+
+static bool WriteTo ( const MIDIMultiTrack &mt, MIDIFileWriteStream *out, double *sec, int num_threads = 1,
+                      bool forward_only = false )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok;
+
+    {
+        MIDIFileWriteMultiTrack writer ( &mt, out, num_threads );
+
+        if ( forward_only )
+            writer.ForwardOnly ( true );
+
+        ok = writer.Write ( mt.GetNumTracks() );
+    }
+
+    *sec = Seconds ( start );
+    return ok;
+}
+
+// write to a timed stream, report the time to the first byte and the throughput
+static bool WriteTimed ( const MIDIMultiTrack &mt, TimedMemoryStream *out, bool forward_only, const char *what )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double sec;
+
+    if ( !WriteTo ( mt, out, &sec, 1, forward_only ) )
+        return false;
+
+    double first_byte_sec = std::chrono::duration<double> ( out->first_byte_time - start ).count();
+    fprintf ( stdout, "  %-28s %10.3f ms to the first byte, %10.2f MB/s\n",
+              what, first_byte_sec * 1e3, out->GetLength() / ( sec > 0. ? sec : 1e-9 ) * 1e-6 );
+    return true;
+}
+
+static std::vector<unsigned char> LoadFile ( const char *fname )
+{
+    std::vector<unsigned char> data;
+    FILE *f = fopen ( fname, "rb" );
+
+    if ( f )
+    {
+        int c;
+
+        while ( ( c = fgetc ( f ) ) != EOF )
+            data.push_back ( ( unsigned char ) c );
+
+        fclose ( f );
+    }
+
+    return data;
+}
+
+static void Report ( const char *what, double bytes, double sec )
+{
+    if ( sec <= 0. )
+        sec = 1e-9;
+
+    fprintf ( stdout, "  %-28s %10.2f MB/s\n", what, bytes / sec * 1e-6 );
+}
+
+int main ( int argc, char **argv )
+{
+    int num_tracks = 32;
+    int events_per_track = 100000;
+    const char *fname = "jdksmidi_bench_write.mid";
+
+    if ( argc > 1 )
+        num_tracks = atoi ( argv[1] );
+
+    if ( argc > 2 )
+        events_per_track = atoi ( argv[2] );
+
+    if ( argc > 3 )
+        fname = argv[3];
+
+    MIDIMultiTrack mt;
+    MakeMultiTrack ( mt, num_tracks, events_per_track );
+    fprintf ( stdout, "tracks %d, events per track %d\n", num_tracks, events_per_track );
+
+    double sec;
+    std::vector<unsigned char> bytes_per_char, bytes_file;
+
+    {
+        ByteFileStream out ( fname );
+
+        if ( !out.IsValid() || !WriteTo ( mt, &out, &sec ) )
+        {
+            fprintf ( stdout, "can't write %s\n", fname );
+            return 1;
+        }
+    }
+
+    bytes_per_char = LoadFile ( fname );
+    fprintf ( stdout, "file size %lu bytes\n", ( unsigned long ) bytes_per_char.size() );
+    Report ( "per byte stream", double ( bytes_per_char.size() ), sec );
+
+    {
+        MIDIFileWriteStreamFileName out ( fname );
+
+        if ( !out.IsValid() || !WriteTo ( mt, &out, &sec ) )
+        {
+            fprintf ( stdout, "can't write %s\n", fname );
+            return 1;
+        }
+    }
+
+    bytes_file = LoadFile ( fname );
+    Report ( "buffered file stream", double ( bytes_file.size() ), sec );
+
+    MIDIFileWriteStreamMemory mem;
+
+    if ( !WriteTo ( mt, &mem, &sec ) )
+    {
+        fprintf ( stdout, "can't write to memory\n" );
+        return 1;
+    }
+
+    Report ( "buffered memory stream", double ( mem.GetLength() ), sec );
+
+    MIDIFileWriteStreamMemory mem_parallel;
+
+    if ( !WriteTo ( mt, &mem_parallel, &sec, 0 ) )
+    {
+        fprintf ( stdout, "can't write to memory\n" );
+        return 1;
+    }
+
+    Report ( "parallel memory stream", double ( mem_parallel.GetLength() ), sec );
+    remove ( fname );
+
+    // the seekable writer sends the first bytes when its buffer is full or it seeks back to
+    // patch the first track length, the forward only writer sends the header at once
+    TimedMemoryStream seekable ( true );
+    TimedMemoryStream pipe ( false );
+    TimedMemoryStream forward ( true );
+
+    if ( !WriteTimed ( mt, &seekable, false, "seekable stream" ) ||
+         !WriteTimed ( mt, &pipe, false, "not seekable stream" ) ||
+         !WriteTimed ( mt, &forward, true, "ForwardOnly(true)" ) )
+    {
+        fprintf ( stdout, "can't write to memory\n" );
+        return 1;
+    }
+
+    bool same = bytes_per_char == bytes_file &&
+                bytes_file.size() == mem.GetLength() &&
+                ( bytes_file.empty() || memcmp ( &bytes_file[0], mem.GetData(), bytes_file.size() ) == 0 ) &&
+                mem_parallel.GetLength() == mem.GetLength() &&
+                ( bytes_file.empty() || memcmp ( mem_parallel.GetData(), mem.GetData(), mem.GetLength() ) == 0 ) &&
+                seekable.GetLength() == mem.GetLength() &&
+                pipe.GetLength() == mem.GetLength() &&
+                forward.GetLength() == mem.GetLength() &&
+                ( mem.GetLength() == 0 ||
+                  ( memcmp ( seekable.GetData(), mem.GetData(), mem.GetLength() ) == 0 &&
+                    memcmp ( pipe.GetData(), mem.GetData(), mem.GetLength() ) == 0 &&
+                    memcmp ( forward.GetData(), mem.GetData(), mem.GetLength() ) == 0 ) );
+
+    if ( !same )
+        fprintf ( stdout, "written files differ\n" );
+
+    return same ? 0 : 1;
+}
@@ -32,6 +32,8 @@
 #include "jdksmidi/queue.h"
 #include "jdksmidi/tick.h"
 
+#include <atomic>
+
 namespace jdksmidi
 {
 
@@ -40,7 +42,8 @@ class MIDIDriver : public MIDITick
 
 public:
 
-    MIDIDriver ( int queue_size );
+    // max_payload is the sysex size each queue slot holds without allocating, see MIDIQueue
+    MIDIDriver ( int queue_size, int max_payload = MIDIQueue::DEFAULT_MAX_PAYLOAD );
     virtual ~MIDIDriver();
 
     virtual void Reset();
@@ -67,6 +70,17 @@ public:
         return &out_queue;
     }
 
+    // to get the midi thru queue
+    MIDIQueue * ThruQueue()
+    {
+        return &thru_queue;
+    }
+
+    const MIDIQueue * ThruQueue() const
+    {
+        return &thru_queue;
+    }
+
 
     //
     // returns true if the output queue is not full
@@ -75,16 +89,44 @@ public:
         return out_queue.CanPut();
     }
 
+    // number of messages that can be output before the out_queue is full
+    int GetOutputSpace() const
+    {
+        return out_queue.GetFreeSpace();
+    }
+
+
+    // number of messages dropped because the in, out or thru queue was full
+    unsigned long GetNumDroppedMessages() const
+    {
+        return num_dropped.load ( std::memory_order_relaxed );
+    }
 
     // processes message with the OutProcessor and then
     // puts the message in the out_queue
-    void OutputMessage ( MIDITimedBigMessage &msg )
+    // returns false if the out_queue was full and the message was dropped
+    // call it, and AllNotesOff(), from one thread only, the producer of the out_queue
+    bool OutputMessage ( MIDITimedBigMessage &msg )
     {
         if ( ( out_proc && out_proc->Process ( &msg ) ) || !out_proc )
         {
-            out_matrix.Process ( msg );
-            out_queue.Put ( msg );
+            return PutOutput ( msg );
         }
+
+        return true;
+    }
+
+    // same for a message that must stay untouched: it is copied only
+    // when an OutProcessor is set
+    bool OutputMessage ( const MIDITimedBigMessage &msg )
+    {
+        if ( out_proc )
+        {
+            MIDITimedBigMessage copy ( msg );
+            return OutputMessage ( copy );
+        }
+
+        return PutOutput ( msg );
     }
 
     void SetThruEnable ( bool f )
@@ -151,10 +193,20 @@ public:
 
 protected:
 
+    // puts the message in the out_queue and keeps track of its notes,
+    // or counts it as dropped
+    bool PutOutput ( const MIDITimedBigMessage &msg );
 
-    // the in and out queues
+    // send the messages of q to HardwareMsgOut(), returns false if the hardware is busy
+    bool SendQueue ( MIDIQueue *q );
+
+    // the queues, each used by one producer and one consumer thread:
+    // in_queue from HardwareMsgIn() to the application,
+    // out_queue from OutputMessage() to TimeTick(),
+    // thru_queue from HardwareMsgIn() to TimeTick(), which sends its messages first
     MIDIQueue in_queue;
     MIDIQueue out_queue;
+    MIDIQueue thru_queue;
 
     // the processors
     MIDIProcessor *in_proc;
@@ -170,6 +222,9 @@ protected:
     // to keep track of notes on going to MIDI out
 
     MIDIMatrix out_matrix;
+
+    // messages dropped by HardwareMsgIn() and OutputMessage(), which run in different threads
+    std::atomic<unsigned long> num_dropped;
 };
 
 
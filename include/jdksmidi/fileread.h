@@ -48,8 +48,11 @@ namespace jdksmidi
 
 class MIDIFileReadStream;
 class MIDIFileReadStreamFile;
+class MIDIFileReadStreamMemory;
+class MIDIFileReadStreamMapped;
 class MIDIFileEvents;
 class MIDIFileRead;
+class MIDIFileReadIncremental;
 
 
 class MIDIFileReadStream
@@ -66,57 +69,174 @@ public:
     virtual void Rewind() = 0;
 
     virtual int ReadChar() = 0;
+
+    ///
+    /// ReadBlock() hands out the next bytes of the stream, which stay valid until the
+    /// next call of ReadBlock(), ReadChar() or Rewind(). The default implementation
+    /// hands out one byte of ReadChar() at a time, block streams override it.
+    /// @param data receives the address of the bytes
+    /// @returns the number of bytes, 0 at end of stream or on error
+    ///
+    virtual int ReadBlock ( const unsigned char **data );
+
+    ///
+    /// @returns true if the blocks of ReadBlock() stay valid until the stream is destroyed,
+    /// and may be written to. MIDIFileRead then passes meta and sysex payloads to the
+    /// MIDIFileEvents handler in place, without copying them.
+    ///
+    virtual bool HasWritableBlocks() const
+    {
+        return false;
+    }
+
+private:
+    unsigned char one_char;
 };
 
+///
+/// MIDIFileReadStreamFile reads the file in blocks of BUFFER_SIZE bytes.
+///
 class MIDIFileReadStreamFile : public MIDIFileReadStream
 {
 public:
-    explicit MIDIFileReadStreamFile ( const char *fname )
-    {
-        f = fopen ( fname, "rb" );
-    }
+    enum { BUFFER_SIZE = 64 * 1024 };
+
+    explicit MIDIFileReadStreamFile ( const char *fname );
 
 #ifdef WIN32
-    explicit MIDIFileReadStreamFile ( const wchar_t *fname )
+    explicit MIDIFileReadStreamFile ( const wchar_t *fname );
+#endif
+
+    explicit MIDIFileReadStreamFile ( FILE *f_ );
+
+    virtual ~MIDIFileReadStreamFile();
+
+    virtual void Rewind();
+
+    bool IsValid()
     {
-        f = _wfopen ( fname, L"rb" );
+        return f != 0;
     }
-#endif
 
-    explicit MIDIFileReadStreamFile ( FILE *f_ ) : f ( f_ )
+    virtual int ReadChar();
+
+    virtual int ReadBlock ( const unsigned char **data );
+
+private:
+    FILE *f;
+
+    unsigned char *buffer;
+    int buffer_pos;
+    int buffer_len;
+};
+
+///
+/// MIDIFileReadStreamMemory reads a midifile already in memory, all of it in one block.
+/// The data is not copied, it must stay valid while the stream is used. If writable_
+/// is true, the data may be written to and MIDIFileRead passes payloads in place.
+///
+class MIDIFileReadStreamMemory : public MIDIFileReadStream
+{
+public:
+    MIDIFileReadStreamMemory ( const void *data_, unsigned long length_, bool writable_ = false )
+        : data ( static_cast<const unsigned char *> ( data_ ) ), length ( length_ ), pos ( 0 ),
+          writable ( writable_ )
     {
     }
 
-    virtual ~MIDIFileReadStreamFile()
+    virtual ~MIDIFileReadStreamMemory()
     {
-        if ( f ) fclose ( f );
     }
 
     virtual void Rewind()
     {
-        if ( f ) rewind ( f );
+        pos = 0;
     }
 
-    bool IsValid()
+    virtual int ReadChar()
     {
-        return f != 0;
+        return ( pos < length ) ? data[pos++] : -1;
     }
 
-    virtual int ReadChar()
+    virtual int ReadBlock ( const unsigned char **block )
+    {
+        int n = ( int ) ( length - pos );
+        *block = data + pos;
+        pos = length;
+        return n;
+    }
+
+    virtual bool HasWritableBlocks() const
     {
-        int r = -1;
+        return writable;
+    }
 
-        if ( f && !feof ( f ) && !ferror ( f ) )
-        {
-            r = fgetc ( f );
-        }
+private:
+    const unsigned char *data;
+    unsigned long length;
+    unsigned long pos;
+    bool writable;
+};
 
-        return r;
+///
+/// MIDIFileReadStreamMapped maps the file to memory and reads all of it in one block.
+/// The mapping is private, so the payloads handed to the MIDIFileEvents handler point
+/// into the mapping and writes to them do not change the file.
+///
+class MIDIFileReadStreamMapped : public MIDIFileReadStream
+{
+public:
+    explicit MIDIFileReadStreamMapped ( const char *fname );
+
+#ifdef WIN32
+    explicit MIDIFileReadStreamMapped ( const wchar_t *fname );
+#endif
+
+    virtual ~MIDIFileReadStreamMapped();
+
+    bool IsValid() const
+    {
+        return data != 0;
+    }
+
+    unsigned long GetLength() const
+    {
+        return length;
+    }
+
+    virtual void Rewind()
+    {
+        pos = 0;
+    }
+
+    virtual int ReadChar()
+    {
+        return ( pos < length ) ? data[pos++] : -1;
     }
 
+    virtual int ReadBlock ( const unsigned char **block )
+    {
+        int n = ( int ) ( length - pos );
+        *block = data + pos;
+        pos = length;
+        return n;
+    }
+
+    virtual bool HasWritableBlocks() const
+    {
+        return true;
+    }
 
 private:
-    FILE *f;
+#ifdef WIN32
+    void Map ( void *file );
+#else
+    void Map ( int fd );
+#endif
+
+    unsigned char *data;
+    unsigned long length;
+    unsigned long pos;
 };
 
 class MIDIFileEvents : protected MIDIFile
@@ -164,6 +284,32 @@ public:
     virtual void mf_endtrack ( int trk );
     virtual void mf_header ( int, int, int );
 
+//
+// Pre-scan of the tracks: if WantTrackEventCounts() returns true, MIDIFileRead::Parse()
+// first counts the events of each MTrk chunk and passes the counts to mf_trackevents(),
+// before mf_header() and the first track, so the handler can reserve its storage
+//
+    virtual bool WantTrackEventCounts() const
+    {
+        return false;
+    }
+    virtual void mf_trackevents ( int ntrks, const int *num_events );
+
+//
+// Chunked payloads: if WantPayloadChunks() returns true, MIDIFileRead hands the meta and sysex
+// payloads longer than its message buffer to mf_payload_begin(), then in pieces of at most that
+// size to mf_payload_continue(), then calls mf_payload_end(), instead of truncating them for
+// MetaEvent() or mf_sysex(). status is 0xFF for meta events, with their type, else the sysex
+// status 0xF0 or 0xF7 and type equals status. Returning false aborts the parse.
+//
+    virtual bool WantPayloadChunks() const
+    {
+        return false;
+    }
+    virtual bool mf_payload_begin ( MIDIClockTime time, int status, int type, unsigned long len );
+    virtual bool mf_payload_continue ( const unsigned char *data, int len );
+    virtual bool mf_payload_end ( MIDIClockTime time );
+
 //
 // Higher level dispatch functions
 //
@@ -190,6 +336,14 @@ public:
     // read midifile header, return number of tracks
     int ReadNumTracks();
 
+    // count the events of each track from the event lengths only, without decoding them.
+    // num_events receives the counts of the tracks scanned, return false on a malformed file
+    bool CountTrackEvents ( std::vector< int > *num_events );
+
+    // parse a stream holding only the MTrk chunk of track track_num, without file header,
+    // return false on error
+    bool ParseTrack ( int track_num );
+
     int GetFormat() const
     {
         return header_format;
@@ -230,10 +384,36 @@ private:
 
     void ReadTrack();
 
+    // skip the events of a track chunk, return their number
+    int CountEvents();
+
     void MsgAdd ( int );
     void MsgInit();
 
-    int EGetC();
+    // read len bytes to the_msg, keeping at most max_msg_len-1 of them
+    void MsgRead ( unsigned long len );
+
+    // read a payload of len bytes, in place if the stream allows it, else to the_msg.
+    // there is always a byte after the returned payload, for a terminating NULL
+    unsigned char *ReadPayload ( unsigned long len, int *payload_len );
+
+    // skip len bytes
+    void SkipBytes ( unsigned long len );
+
+    // hand a payload of len bytes to the handler in pieces, return false to abort
+    bool ReadPayloadChunks ( int status, int type, unsigned long len );
+
+    int EGetC()
+    {
+        if ( cur_pos == end_pos )
+            return EGetCFromNextBlock();
+
+        --to_be_read;
+        return *cur_pos++;
+    }
+
+    // refill the stream buffer, then read the next char
+    int EGetCFromNextBlock();
 
     int ReadMT ( unsigned long, int );
 
@@ -249,7 +429,122 @@ private:
 
     MIDIFileReadStream *input_stream;
     MIDIFileEvents *event_handler;
+
+    // the unread bytes of the current block of input_stream
+    const unsigned char *cur_pos;
+    const unsigned char *end_pos;
+
+    // input_stream->HasWritableBlocks()
+    bool payloads_in_place;
+
+    // true during CountTrackEvents(), which reports nothing to event_handler
+    bool counting;
 };
+///
+/// MIDIFileReadIncremental parses a midifile pushed to it in pieces of any size, as they
+/// arrive, instead of pulling it from a MIDIFileReadStream. It calls the MIDIFileEvents
+/// handler like MIDIFileRead::Parse(), as soon as each event is complete, and keeps only
+/// the bytes of an incomplete event or chunk header between the pieces. Meta and sysex
+/// payloads are taken as they arrive: in pieces if the handler WantPayloadChunks() and the
+/// payload is max_msg_len bytes or longer, else their first max_msg_len-1 bytes.
+///
+class MIDIFileReadIncremental : protected MIDIFile
+{
+public:
+    MIDIFileReadIncremental ( MIDIFileEvents *event_handler_, unsigned long max_msg_len = 8192 );
+
+    virtual ~MIDIFileReadIncremental();
+
+    // forget the pieces fed so far, to parse another file
+    void Reset();
+
+    ///
+    /// Feed() parses the next len bytes of the file, the data is not needed after the call.
+    /// Bytes after the last track are ignored.
+    /// @returns false after an error, the following pieces are ignored
+    ///
+    bool Feed ( const void *data, unsigned long len );
+
+    ///
+    /// Finish() tells that no more pieces follow, an incomplete file is reported as error.
+    /// @returns true if all tracks of the file were parsed
+    ///
+    bool Finish();
+
+    // true when all tracks of the file were parsed
+    bool IsComplete() const
+    {
+        return state == DONE;
+    }
+
+    int GetFormat() const
+    {
+        return header_format;
+    }
+    int GetNumTracks() const
+    {
+        return header_ntrks;
+    }
+    int GetDivision() const
+    {
+        return header_division;
+    }
+    bool UsedRunningStatus() const
+    {
+        return used_running_status;
+    }
+
+private:
+
+    enum State { FIND_HEADER, HEADER, TRACK_HEADER, TRACK_EVENTS, PAYLOAD, DONE, FAILED };
+
+    // parse as many header, chunk header and event units as the n bytes at p hold,
+    // return the number of bytes used
+    unsigned long ParseUnits ( const unsigned char *p, unsigned long n );
+
+    // parse the unit at p, return its length, or 0 if it is incomplete and needs
+    // need_bytes bytes, or if the state changed
+    unsigned long ParseUnit ( const unsigned char *p, unsigned long n );
+
+    // parse the event at p, return its length, or 0 if it is incomplete.
+    // for meta and sysex events only their header, then the state is PAYLOAD
+    unsigned long ParseEvent ( const unsigned char *p, unsigned long n );
+
+    // take the next n bytes of the payload at p, return how many were used
+    unsigned long ParsePayload ( const unsigned char *p, unsigned long n );
+
+    void EndTrack();
+    void Abort();
+    void Fail ( const char *e );
+
+    MIDIFileEvents *event_handler;
+
+    State state;
+    int header_format;
+    int header_ntrks;
+    int header_division;
+    bool used_running_status;
+
+    int cur_track;
+    MIDIClockTime cur_time;
+    unsigned long to_be_read;
+    int status;
+
+    unsigned char *the_msg;
+    int max_msg_len;
+    int act_msg_len;
+
+    // the meta or sysex event whose payload is parsed in the PAYLOAD state
+    int payload_status;
+    int payload_type;
+    unsigned long payload_left;
+    bool payload_chunks;
+
+    // the start of an incomplete unit, and the bytes it needs
+    std::vector< unsigned char > pending;
+    unsigned long need_bytes;
+};
+
 }
 
 #endif
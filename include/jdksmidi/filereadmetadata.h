@@ -0,0 +1,142 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef JDKSMIDI_FILEREADMETADATA_H
+#define JDKSMIDI_FILEREADMETADATA_H
+
+#include "jdksmidi/fileread.h"
+#include "jdksmidi/tempo.h"
+
+namespace jdksmidi
+{
+
+///
+/// MIDIFileMetadata is the summary of a midifile found by MIDIFileReadMetadata.
+/// Like MIDISequencer, the tempo and time signature maps come from the first track.
+///
+class MIDIFileMetadata
+{
+public:
+    struct TempoChange
+    {
+        MIDIClockTime time;
+        // the tempo in effect, limited like MIDITempoMap::LimitTempo()
+        unsigned long usec_per_beat;
+        double time_ms;
+    };
+
+    struct TimeSigChange
+    {
+        MIDIClockTime time;
+        int numerator;
+        int denominator;
+    };
+
+    struct TrackInfo
+    {
+        std::string name;
+        // all events, as loaded into a MIDITrack
+        int num_events;
+        int num_notes;
+        // bit n is set if the track has events on channel n
+        unsigned short channels;
+        // time of the last event before the end of track
+        MIDIClockTime end_time;
+    };
+
+    MIDIFileMetadata();
+
+    void Clear();
+
+    ///
+    /// TicksToMs() converts a time in midi ticks to milliseconds, with the tempo map, in
+    /// O(log number of tempo changes). Before the first tempo change the tempo is 120 beats
+    /// per minute, with a smpte division the tempo does not matter.
+    ///
+    double TicksToMs ( MIDIClockTime t ) const;
+
+    // the same for a time t at or after the tempo change from, and before the next one
+    double TicksToMs ( const TempoChange &from, MIDIClockTime t ) const;
+
+    int format;
+    int num_tracks;
+    int division;
+
+    std::vector< TempoChange > tempo_map;
+    std::vector< TimeSigChange > timesig_map;
+    std::vector< TrackInfo > tracks;
+
+    // the sums of all tracks
+    int num_events;
+    int num_notes;
+    unsigned short channels;
+
+    // time of the last event before the end of track of all tracks
+    MIDIClockTime duration_ticks;
+    double duration_ms;
+};
+
+///
+/// MIDIFileReadMetadata fills a MIDIFileMetadata in a single pass of MIDIFileRead over
+/// the file. It keeps no events, so it takes no memory proportional to their number.
+///
+class MIDIFileReadMetadata : public MIDIFileEvents
+{
+public:
+    MIDIFileReadMetadata ( MIDIFileMetadata *md );
+
+    virtual ~MIDIFileReadMetadata();
+
+    virtual void mf_header ( int, int, int );
+    virtual void mf_starttrack ( int trk );
+    virtual void mf_endtrack ( int trk );
+
+    virtual bool ChanMessage ( const MIDITimedMessage &msg );
+
+    virtual bool mf_metamisc ( MIDIClockTime time, int type, int len, unsigned char *data );
+    virtual bool mf_timesig ( MIDIClockTime time, int, int, int, int );
+    virtual bool mf_tempo ( MIDIClockTime time, unsigned char a, unsigned char b, unsigned char c );
+    virtual bool mf_keysig ( MIDIClockTime time, int, int );
+    virtual bool mf_sqspecific ( MIDIClockTime time, int, unsigned char * );
+    virtual bool mf_text ( MIDIClockTime time, int, int, unsigned char * );
+    virtual bool mf_sysex ( MIDIClockTime time, int type, int len, unsigned char *s );
+    virtual bool mf_eot ( MIDIClockTime time );
+
+protected:
+
+    // count an event of the current track
+    void AddEvent ( MIDIClockTime time )
+    {
+        ++track->num_events;
+        track->end_time = time;
+    }
+
+    MIDIFileMetadata *metadata;
+    MIDIFileMetadata::TrackInfo *track;
+    int cur_track;
+};
+
+}
+
+#endif
@@ -51,7 +51,9 @@ namespace jdksmidi
 class MIDIFileReadMultiTrack : public MIDIFileEvents
 {
 public:
-    MIDIFileReadMultiTrack ( MIDIMultiTrack *mlttrk );
+    /// @param presize_tracks_ if true, Parse() counts the events of each track first and
+    /// the tracks reserve exactly that many events, so they do not grow while loading
+    MIDIFileReadMultiTrack ( MIDIMultiTrack *mlttrk, bool presize_tracks_ = false );
 
     virtual ~MIDIFileReadMultiTrack();
 
@@ -78,6 +80,12 @@ public:
     virtual void mf_endtrack ( int trk );
     virtual void mf_header ( int, int, int );
 
+    virtual bool WantTrackEventCounts() const
+    {
+        return presize_tracks;
+    }
+    virtual void mf_trackevents ( int ntrks, const int *num_events );
+
 //
 // Higher level dispatch functions
 //
@@ -98,6 +106,133 @@ protected:
     int num_tracks;
     int division;
 
+    bool presize_tracks;
+};
+
+///
+/// MIDIFileTrackChunks finds the header and the MTrk chunks of a midifile in memory,
+/// without parsing the events. It is the common part of the loaders below.
+///
+class MIDIFileTrackChunks
+{
+public:
+    MIDIFileTrackChunks();
+
+    virtual ~MIDIFileTrackChunks();
+
+    int GetFormat() const
+    {
+        return header_format;
+    }
+    int GetNumTracks() const
+    {
+        return header_ntrks;
+    }
+    int GetDivision() const
+    {
+        return header_division;
+    }
+
+    /// @returns the first error of track trk, or 0 if it loaded without error
+    const char *GetTrackError ( int trk ) const;
+
+protected:
+
+    // a MTrk chunk, with its header
+    struct Chunk
+    {
+        int track_num;
+        unsigned long offset;
+        unsigned long length;
+        bool used_running_status;
+
+        static bool larger ( const Chunk &c1, const Chunk &c2 )
+        {
+            return ( c1.length > c2.length );
+        }
+    };
+
+    // find the header and the track chunks of the file, in track order, return false if there is no header
+    bool FindChunks ( const unsigned char *data, unsigned long length, std::vector< Chunk > *chunks );
+
+    // parse the chunk into its track of multitrack, keeping the first error in track_errors
+    void ParseChunk ( MIDIMultiTrack *multitrack, const unsigned char *data, bool writable, Chunk *c );
+
+    int header_format;
+    int header_ntrks;
+    int header_division;
+
+    std::vector< std::string > track_errors;
+};
+
+///
+/// MIDIFileReadMultiTrackParallel loads a midifile in memory into a multitrack like
+/// MIDIFileRead with MIDIFileReadMultiTrack, but decodes the MTrk chunks concurrently.
+/// It finds the chunks first, then worker threads take them, largest first, and parse
+/// each straight into its own track. An error in one track does not stop the others.
+///
+class MIDIFileReadMultiTrackParallel : public MIDIFileTrackChunks
+{
+public:
+    /// @param num_threads number of worker threads, 0 for one per hardware thread
+    MIDIFileReadMultiTrackParallel ( MIDIMultiTrack *mlttrk, int num_threads = 0 );
+
+    virtual ~MIDIFileReadMultiTrackParallel();
+
+    ///
+    /// Parse() clears and resizes the multitrack to the number of tracks of the file, then loads it.
+    /// If writable is true, data may be written to and payloads are parsed in place.
+    /// @returns false if the file has no tracks or any track has an error
+    ///
+    bool Parse ( const void *data, unsigned long length, bool writable = false );
+
+    bool UsedRunningStatus() const
+    {
+        return used_running_status;
+    }
+
+protected:
+
+    // parse the chunks from *next_chunk on, until there are no more, next_chunk is a std::atomic<int>
+    void ParseChunks ( const unsigned char *data, bool writable, std::vector< Chunk > *chunks, void *next_chunk );
+
+    MIDIMultiTrack *multitrack;
+    int num_threads;
+
+    bool used_running_status;
+};
+
+///
+/// MIDIFileReadMultiTrackLazy loads the tracks of a midifile on demand. Open() maps the file,
+/// finds its MTrk chunks and becomes the track loader of the multitrack, so a track is decoded
+/// on its first access only. It must stay alive while the multitrack loads tracks from it.
+///
+class MIDIFileReadMultiTrackLazy : public MIDIFileTrackChunks, public MIDITrackLoader
+{
+public:
+    MIDIFileReadMultiTrackLazy();
+
+    virtual ~MIDIFileReadMultiTrackLazy();
+
+    ///
+    /// Open() clears and resizes the multitrack to the number of tracks of the file, without
+    /// loading them. See MIDIMultiTrack::SetTrackLoader() for max_loaded_tracks.
+    /// @returns false if the file can not be read or has no tracks
+    ///
+    bool Open ( const char *fname, MIDIMultiTrack *mlttrk, int max_loaded_tracks = 0 );
+
+    // unmap the file, the tracks not loaded yet stay empty
+    void Close();
+
+    virtual bool LoadTrack ( MIDIMultiTrack *mt, int track_num );
+
+protected:
+
+    MIDIFileReadStreamMapped *stream;
+    const unsigned char *data;
+    MIDIMultiTrack *multitrack;
+
+    std::vector< Chunk > chunks;
 };
 
 }
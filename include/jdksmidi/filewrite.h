@@ -48,6 +48,7 @@ namespace jdksmidi
 
 class MIDIFileWriteStream;
 class MIDIFileWriteStreamFile;
+class MIDIFileWriteStreamMemory;
 class MIDIFileWrite;
 
 class MIDIFileWriteStream
@@ -58,6 +59,19 @@ public:
 
     virtual long Seek ( long pos, int whence = SEEK_SET ) = 0;
     virtual int WriteChar ( int c ) = 0;
+
+    ///
+    /// WriteBlock() writes len bytes. The default implementation writes them one at a time
+    /// with WriteChar(), block streams override it.
+    /// @returns len, or -1 on error
+    ///
+    virtual int WriteBlock ( const unsigned char *data, int len );
+
+    ///
+    /// IsSeekable() returns false for streams that can only be written forward (pipes, sockets),
+    /// MIDIFileWrite then never seeks on them. The default implementation returns true.
+    ///
+    virtual bool IsSeekable();
 };
 
 class MIDIFileWriteStreamFile : public MIDIFileWriteStream
@@ -68,6 +82,8 @@ public:
 
     long Seek ( long pos, int whence = SEEK_SET );
     int WriteChar ( int c );
+    int WriteBlock ( const unsigned char *data, int len );
+    bool IsSeekable();
 protected:
     FILE *f;
 };
@@ -100,12 +116,80 @@ public:
 
 };
 
+///
+/// MIDIFileWriteStreamMemory writes the midifile to a growing buffer in memory.
+///
+class MIDIFileWriteStreamMemory : public MIDIFileWriteStream
+{
+public:
+    MIDIFileWriteStreamMemory();
+    virtual ~MIDIFileWriteStreamMemory();
+
+    long Seek ( long pos, int whence = SEEK_SET );
+    int WriteChar ( int c );
+    int WriteBlock ( const unsigned char *data, int len );
+
+    // the bytes written, valid until the next write
+    const unsigned char *GetData() const
+    {
+        return data.empty() ? 0 : &data[0];
+    }
+    unsigned long GetLength() const
+    {
+        return ( unsigned long ) data.size();
+    }
+
+    // the buffer, to take over the file with swap()
+    std::vector< unsigned char > &GetBuffer()
+    {
+        return data;
+    }
+
+    void Clear()
+    {
+        data.clear();
+        pos = 0;
+    }
+
+private:
+    std::vector< unsigned char > data;
+    unsigned long pos;
+};
+
+///
+/// MIDIFileWrite encodes into a buffer of BUFFER_SIZE bytes and writes it to the stream in
+/// blocks, when it is full, before each seek, on Flush() and on destruction. Destroy or
+/// flush the writer before the stream.
+///
+/// In forward only mode (the default for streams that are not seekable) the writer never
+/// seeks: a track is kept in the buffer, which grows as needed, from WriteTrackHeader() until
+/// RewriteTrackLength() patches its length in place and writes it out. A track not finished by
+/// RewriteTrackLength() when the writer is destroyed, e.g. after an error, is discarded:
+/// the stream ends with the preceding complete tracks.
+///
 class MIDIFileWrite : protected MIDIFile
 {
 public:
+    enum { BUFFER_SIZE = 64 * 1024 };
+
     MIDIFileWrite ( MIDIFileWriteStream *out_stream_ );
     virtual ~MIDIFileWrite();
 
+    // write the buffered bytes to the stream, return false if an error occurred;
+    // in forward only mode, the bytes of a track whose length is not known yet stay buffered,
+    // and are lost if the writer is destroyed before RewriteTrackLength()
+    bool Flush();
+
+    // true argument never seeks on the stream (on default true for streams that are not seekable)
+    void ForwardOnly ( bool forward )
+    {
+        forward_only = forward;
+    }
+    bool IsForwardOnly() const
+    {
+        return forward_only;
+    }
+
     bool ErrorOccurred()
     {
         return error;
@@ -159,12 +243,19 @@ protected:
 
     void WriteCharacter ( uchar c )
     {
-        if ( out_stream->WriteChar ( c ) < 0 )
-            error = true;
+        if ( buffer_len == buffer_size )
+            Overflow();
+
+        buffer[buffer_len++] = c;
     }
 
+    void WriteBytes ( const unsigned char *data, unsigned long len );
+    void Overflow();
+
     void Seek ( long pos )
     {
+        Flush();
+
         if ( out_stream->Seek ( pos ) < 0 )
             error = true;
     }
@@ -192,6 +283,13 @@ private:
     uchar running_status;
 
     MIDIFileWriteStream *out_stream;
+
+    bool forward_only;
+    int track_header_pos; // buffer position of the pending track header in forward only mode, or -1
+
+    unsigned char *buffer;
+    int buffer_len;
+    int buffer_size;
 };
 }
 
@@ -32,6 +32,8 @@
 #include "jdksmidi/filewrite.h"
 #include "jdksmidi/multitrack.h"
 
+#include <atomic>
+
 namespace jdksmidi
 {
 
@@ -39,9 +41,15 @@ class MIDIFileWriteMultiTrack
 {
 public:
 
+    /// @param num_threads_ number of threads encoding tracks, 1 writes them serially,
+    /// 0 uses one per hardware thread. With more than one, every track is encoded to its own
+    /// memory buffer concurrently and the buffers are written behind the header in order; the
+    /// file is byte-identical to the serial one. All encoded tracks are held in memory until
+    /// they are written, so the peak memory grows by the size of the whole file.
     MIDIFileWriteMultiTrack (
         const MIDIMultiTrack *mlt_,
-        MIDIFileWriteStream *strm_
+        MIDIFileWriteStream *strm_,
+        int num_threads_ = 1
     );
 
     virtual ~MIDIFileWriteMultiTrack();
@@ -60,15 +68,37 @@ public:
     // false argument disable use running status in midi file (true on default)
     void UseRunningStatus( bool use )
     {
+        use_running_status = use;
         writer.UseRunningStatus( use );
     }
 
+    // true argument writes the file strictly forward, one buffered track at a time, without seeks
+    // (on default true for streams that are not seekable: pipes, sockets)
+    void ForwardOnly( bool forward )
+    {
+        writer.ForwardOnly( forward );
+    }
+
 private:
     virtual bool PreWrite();
     virtual bool PostWrite();
 
+    // encode the events of track t with w, from the track header to the patched track length
+    static bool WriteTrack ( MIDIFileWrite *w, const MIDITrack *t );
+
+    // one track encoded to memory by WriteTracksParallel()
+    struct TrackJob;
+
+    bool WriteTracksParallel ( int num_tracks );
+
+    // encode the jobs from *next_job on, until there are no more
+    void EncodeTracks ( std::vector< TrackJob * > *jobs, std::atomic<int> *next_job );
+
     const MIDIMultiTrack *multitrack;
+    MIDIFileWriteStream *stream;
     MIDIFileWrite writer;
+    int num_threads;
+    bool use_running_status;
 };
 
 }
@@ -107,6 +107,8 @@ protected:
     long repeat_start_measure;
     long repeat_end_measure;
 
+    // the events of one time tick, reused from tick to tick
+    std::vector< MIDISequencerEvent > play_events;
 
 };
 
@@ -574,7 +574,10 @@ protected:
 /// The MIDIBigMessage inherits from a MIDIMessage and adds the capability of storing
 /// a dynamically allocated MIDISystemExclusive message inside in case the the message needs to
 /// store a sysex.  If it does not need to store a sysex, typically the MIDISysexExclusive is not
-/// allocated
+/// allocated. Copying a message into one that already owns a big enough MIDISystemExclusive
+/// reuses it without any allocation. The sysex can also be attached with AttachSysEx(), in this
+/// case it is owned by someone else (typically the payload arena of a MIDITrack or the slots
+/// of a MIDIQueue) and the message does not delete it.
 ///
 
 class MIDIBigMessage : public MIDIMessage
@@ -588,12 +591,38 @@ public:
 
     MIDIBigMessage ( const MIDIBigMessage &m );
 
+    /// take over the sysex of m without copying it, m is left without sysex
+    MIDIBigMessage ( MIDIBigMessage &&m ) noexcept
+        :
+        MIDIMessage ( m ),
+        sysex_attached ( m.sysex_attached ),
+        sysex ( m.sysex )
+    {
+        m.sysex_attached = false;
+        m.sysex = 0;
+    }
+
     MIDIBigMessage ( const MIDIMessage &m );
 
     MIDIBigMessage ( const MIDIMessage &m, const MIDISystemExclusive *e );
 
     const MIDIBigMessage &operator = ( const MIDIBigMessage &m );
 
+    const MIDIBigMessage &operator = ( MIDIBigMessage &&m ) noexcept
+    {
+        if ( this != &m )
+        {
+            ClearSysEx();
+            MIDIMessage::operator = ( m );
+            sysex = m.sysex;
+            sysex_attached = m.sysex_attached;
+            m.sysex = 0;
+            m.sysex_attached = false;
+        }
+
+        return *this;
+    }
+
     const MIDIBigMessage &operator = ( const MIDIMessage &m );
 
 
@@ -603,6 +632,28 @@ public:
 
     void CopySysEx ( const MIDISystemExclusive *e );
 
+    /// Exchange the contents of two messages. The attached sysex buffers are handed over, not copied.
+    void Swap ( MIDIBigMessage &m )
+    {
+        MIDIMessage tmp ( m );
+        m.MIDIMessage::operator = ( *this );
+        MIDIMessage::operator = ( tmp );
+        std::swap ( sysex, m.sysex );
+        std::swap ( sysex_attached, m.sysex_attached );
+    }
+
+    ///
+    /// Attach a sysex owned by someone else, who must keep it alive as long as the message uses it.
+    /// Copies of the message get their own copy of the sysex.
+    ///
+    void AttachSysEx ( MIDISystemExclusive *e );
+
+    /// true if the sysex belongs to someone else, see AttachSysEx()
+    bool IsSysExAttached() const
+    {
+        return sysex_attached;
+    }
+
     //@}
 
 
@@ -641,6 +692,7 @@ public:
 
 protected:
 
+    bool sysex_attached; // sysex is not owned by the message
     MIDISystemExclusive *sysex;
 };
 
@@ -761,6 +813,13 @@ public:
 
     MIDITimedBigMessage ( const MIDITimedBigMessage &m );
 
+    MIDITimedBigMessage ( MIDITimedBigMessage &&m ) noexcept
+        :
+        MIDIBigMessage ( std::move ( m ) ),
+        time ( m.time )
+    {
+    }
+
     MIDITimedBigMessage ( const MIDIBigMessage &m );
 
     MIDITimedBigMessage ( const MIDITimedMessage &m );
@@ -775,12 +834,26 @@ public:
 
     void Copy ( const MIDITimedMessage &m );
 
+    // exchange contents and times of two messages without copying the sysex buffers
+    void Swap ( MIDITimedBigMessage &m )
+    {
+        std::swap ( time, m.time );
+        MIDIBigMessage::Swap ( m );
+    }
+
     //
     // operator =
     //
 
     const MIDITimedBigMessage &operator = ( const MIDITimedBigMessage & m );
 
+    const MIDITimedBigMessage &operator = ( MIDITimedBigMessage && m ) noexcept
+    {
+        time = m.time;
+        MIDIBigMessage::operator = ( std::move ( m ) );
+        return *this;
+    }
+
     const MIDITimedBigMessage &operator = ( const MIDITimedMessage & m );
 
     const MIDITimedBigMessage &operator = ( const MIDIMessage & m );
@@ -46,6 +46,46 @@ namespace jdksmidi
 class MIDIMultiTrack;
 class MIDIMultiTrackIteratorState;
 class MIDIMultiTrackIterator;
+class MIDITrackLoader;
+
+///
+/// MIDITrackLoader fills the tracks of a lazily loaded MIDIMultiTrack on demand,
+/// see MIDIMultiTrack::SetTrackLoader().
+///
+class MIDITrackLoader
+{
+public:
+    virtual ~MIDITrackLoader()
+    {
+    }
+
+    ///
+    /// LoadTrack() puts the events of track track_num into mt->GetTrack(track_num), which is empty.
+    /// @returns false on error, the events loaded until then stay in the track
+    ///
+    virtual bool LoadTrack ( MIDIMultiTrack *mt, int track_num ) = 0;
+};
+
+///
+/// MIDIMultiTrackStatistics are the figures of a whole MIDIMultiTrack, see MIDIMultiTrack::GetStatistics().
+///
+class MIDIMultiTrackStatistics
+{
+public:
+    MIDIMultiTrackStatistics()
+        : duration_ticks ( 0 ), duration_ms ( 0. ), num_events ( 0 ), num_notes ( 0 )
+    {
+    }
+
+    // time of the last event which is not an end of track
+    MIDIClockTime duration_ticks;
+    // the same in milliseconds, through the tempo changes of track 0
+    double duration_ms;
+    // number of events of all tracks
+    int num_events;
+    // number of note on events with velocity > 0
+    int num_notes;
+};
 
 class MIDIMultiTrack
 {
@@ -57,24 +97,61 @@ private:
 public:
 
     MIDIMultiTrack ( int max_num_tracks_ = 64, bool deletable_ = true );
+
+    // take over the tracks of mt, which is left without tracks
+    MIDIMultiTrack ( MIDIMultiTrack &&mt );
+
     virtual ~MIDIMultiTrack();
 
-    void SetTrack ( int track_num, MIDITrack *track )
-    {
-        tracks[track_num] = track;
-    }
+    const MIDIMultiTrack & operator = ( MIDIMultiTrack &&mt );
 
+    // the changes of the track are counted by this multitrack, so a track given to several
+    // multitracks is only seen changing by the last one
+    void SetTrack ( int track_num, MIDITrack *track );
+
+    // with a track loader, the track is loaded on its first access
     MIDITrack *GetTrack ( int track_num )
     {
         assert( track_num < number_of_tracks );
+        if ( track_loader )
+            UseTrack ( track_num );
         return tracks[track_num];
     }
     const MIDITrack *GetTrack ( int track_num ) const
     {
         assert( track_num < number_of_tracks );
+        if ( track_loader )
+            UseTrack ( track_num );
         return tracks[track_num];
     }
 
+    ///
+    /// SetTrackLoader() makes the multitrack load its tracks lazily: all tracks are marked
+    /// not loaded, and the first access of a track through GetTrack() has loader fill it.
+    /// The loader must stay valid until it is replaced, or the multitrack is cleared or resized.
+    /// @param loader the track loader, 0 to load no more tracks
+    /// @param max_loaded_tracks_ if > 0, loading a track beyond this many unloads the
+    /// track not accessed for the longest time. Unloading invalidates the event pointers
+    /// of the track, so keep it at least the number of tracks used at the same time.
+    /// Tracks edited since they were loaded are kept, even beyond this limit, as unloading
+    /// would discard the edits
+    ///
+    void SetTrackLoader ( MIDITrackLoader *loader, int max_loaded_tracks_ = 0 );
+
+    MIDITrackLoader *GetTrackLoader() const
+    {
+        return track_loader;
+    }
+
+    bool IsTrackLoaded ( int track_num ) const
+    {
+        return !track_loader || track_use[track_num] != 0;
+    }
+
+    // free the events of a loaded track, it is loaded again on its next access.
+    // edits of the track since it was loaded are discarded, the loader restores the original events
+    void UnloadTrack ( int track_num );
+
     int GetNumTracks() const
     {
         return number_of_tracks;
@@ -108,23 +185,89 @@ public:
     void SetClksPerBeat ( int cpb )
     {
         clks_per_beat = cpb;
+        ++version;
     }
 
     int GetNumEvents() const
     {
         int num_events = 0;
         for ( int i = 0; i < number_of_tracks; ++i )
-            num_events += tracks[i]->GetNumEvents();
+            num_events += GetTrack ( i )->GetNumEvents();
         return num_events;
     }
 
+    ///
+    /// GetVersion() grows with every change of the multitrack or of the events of its tracks,
+    /// so an unchanged version means unchanged contents. The tracks count their changes in a
+    /// counter of the multitrack, so it costs O(1), only the first call after non const accesses
+    /// to events costs O(number of tracks), see MIDITrack::GetEventAddress().
+    /// Loading and unloading tracks with a track loader do not change it.
+    ///
+    unsigned long GetVersion() const;
+
+    ///
+    /// GetStatistics() returns the duration and the event and note counts of all tracks.
+    /// They are computed once and cached until the version changes, so repeated queries
+    /// only check the version. Not safe to call from several threads at the same time.
+    ///
+    const MIDIMultiTrackStatistics &GetStatistics() const;
+
+    MIDIClockTime GetDurationTicks() const
+    {
+        return GetStatistics().duration_ticks;
+    }
+
+    double GetDurationMs() const
+    {
+        return GetStatistics().duration_ms;
+    }
+
+    int GetNumNotes() const
+    {
+        return GetStatistics().num_notes;
+    }
+
 protected:
 
+    // make GetVersion() old_version + 1 after tracks were added, removed or replaced
+    void TracksReplaced ( unsigned long old_version )
+    {
+        version += old_version + 1 - GetVersion();
+    }
+
+    // load the track if not loaded, and mark it as just used
+    void UseTrack ( int track_num ) const;
+
+    // have all tracks count their changes in track_changes
+    void AttachTracks();
+
+    // stop the tracks counting their changes in track_changes
+    void DetachTracks();
+
     MIDITrack **tracks;
     int number_of_tracks;
     bool deletable;
 
     int clks_per_beat;
+
+    // GetVersion() is version plus the changes of the tracks, minus load_changes, modulo 2^n
+    unsigned long version;
+    mutable MIDITrackChanges track_changes;
+
+    mutable MIDIMultiTrackStatistics statistics;
+    mutable unsigned long statistics_version;
+    mutable bool statistics_valid;
+
+    MIDITrackLoader *track_loader;
+    int max_loaded_tracks;
+    mutable int num_loaded_tracks;
+    // per track the use_count of its last access, 0 if not loaded
+    mutable unsigned long *track_use;
+    // the track changes made by loading and unloading tracks, which GetVersion() subtracts,
+    // and per track its version when it was last loaded
+    mutable unsigned long load_changes;
+    mutable unsigned long *track_loaded_version;
+    mutable unsigned long use_count;
 };
 
 class MIDIMultiTrackIteratorState
@@ -151,13 +294,36 @@ public:
     }
 
     void Reset();
+
+    ///
+    /// FindTrackOfFirstEvent() finds the track with the earliest next event, O(log num_tracks).
+    /// On equal times the first such track after cur_event_track wins, wrapping around to track 0.
+    /// @returns the track number, -1 if all tracks are at end
+    ///
     int FindTrackOfFirstEvent();
 
+    ///
+    /// UpdateTrack() must follow each change of next_event_number[track_num] or
+    /// next_event_time[track_num], UpdateAllTracks() a change of many tracks.
+    ///
+    void UpdateTrack ( int track_num );
+    void UpdateAllTracks();
+
     MIDIClockTime cur_time;
     int cur_event_track;
     int num_tracks;
     int *next_event_number;
     MIDIClockTime *next_event_time;
+
+private:
+
+    // first track >= track_num with time of next event <= time, -1 if none
+    int FindFirstTrackAtOrBefore ( int track_num, MIDIClockTime time ) const;
+
+    // tournament tree of the next event times, leaf of track i is min_time[num_leaves + i],
+    // node n holds the minimum of nodes 2n and 2n+1, tracks at end hold 0xffffffff
+    int num_leaves;
+    MIDIClockTime *min_time;
 };
 
 class MIDIMultiTrackIterator
@@ -28,15 +28,41 @@
 #include "jdksmidi/msg.h"
 #include "jdksmidi/sysex.h"
 
+#include <atomic>
+#include <vector>
+
 namespace jdksmidi
 {
 
+///
+/// MIDIQueue is a lock-free ring buffer of messages between one producer thread, calling
+/// CanPut(), GetFreeSpace() and Put(), and one consumer thread, calling CanGet(), Peek(),
+/// Get() and Next(). The indices are published with release stores and read with acquire
+/// loads, so a message is completely written before the consumer sees it, and completely
+/// read before the producer reuses its slot.
+/// Each slot has room for max_payload bytes of sysex, text or meta payload, allocated once
+/// by the constructor, so Put() and Get() never allocate memory for such payloads. A longer
+/// payload is not dropped: Put() gives the slot its own copy of it on the heap, which does
+/// allocate. Choose max_payload above the longest payload the producer thread sends if that
+/// thread must not allocate.
+///
 class MIDIQueue
 {
 public:
-    MIDIQueue ( int num_msgs );
+    enum
+    {
+        DEFAULT_MAX_PAYLOAD = 256,
+        CACHE_LINE_SIZE = 64
+    };
+
+    ///
+    /// @param num_msgs number of slots, the queue holds up to num_msgs - 1 messages
+    /// @param max_payload_ payload bytes per slot, longer payloads are copied to the heap
+    ///
+    MIDIQueue ( int num_msgs, int max_payload_ = DEFAULT_MAX_PAYLOAD );
     virtual ~MIDIQueue();
 
+    // empty the queue, only while neither thread uses it
     void Clear();
 
     bool CanPut() const;
@@ -48,33 +74,62 @@ public:
         return !CanPut();
     }
 
+    // number of messages that can be put before the queue is full
+    int GetFreeSpace() const;
 
-    void Put ( const MIDITimedBigMessage &msg )
+    int GetMaxPayload() const
     {
-        buf[next_in] = msg;
-        next_in = ( next_in + 1 ) % bufsize;
+        return max_payload;
     }
 
-    MIDITimedBigMessage Get() const
+    ///
+    /// Put() copies msg and its payload into the next slot.
+    /// @returns false if the queue is full
+    ///
+    bool Put ( const MIDITimedBigMessage &msg );
+
+    // the oldest message, valid until Next(); call only after CanGet() returned true
+    const MIDITimedBigMessage &Get() const
     {
-        return MIDITimedBigMessage ( buf[next_out] );
+        return buf[next_out.load ( std::memory_order_relaxed )];
     }
 
+    // remove the oldest message, giving its slot back to the producer
     void Next()
     {
-        next_out = ( next_out + 1 ) % bufsize;
+        int out = next_out.load ( std::memory_order_relaxed ) + 1;
+        next_out.store ( ( out == bufsize ) ? 0 : out, std::memory_order_release );
     }
 
     const MIDITimedBigMessage *Peek() const
     {
-        return &buf[next_out];
+        return &buf[next_out.load ( std::memory_order_relaxed )];
     }
 
 protected:
     MIDITimedBigMessage *buf;
+    unsigned char *payload; // max_payload bytes per slot
+    std::vector<MIDISystemExclusive> slot_sysex; // attached to the slots, refer to payload
     int bufsize;
-    volatile int next_in;
-    volatile int next_out;
+    int max_payload;
+
+    // the producer side: next_in and its last seen next_out, a cache line apart from the
+    // consumer side, so the two threads do not write to the same cache line
+    char pad0[CACHE_LINE_SIZE];
+    std::atomic<int> next_in;
+    mutable int cached_out;
+    char pad1[CACHE_LINE_SIZE];
+
+    // the consumer side: next_out and its last seen next_in
+    std::atomic<int> next_out;
+    mutable int cached_in;
+    char pad2[CACHE_LINE_SIZE];
+
+private:
+
+    // not copyable, the slots refer to the payload storage
+    MIDIQueue ( const MIDIQueue & );
+    const MIDIQueue & operator = ( const MIDIQueue & );
 };
 
 }
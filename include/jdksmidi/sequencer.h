@@ -209,6 +209,19 @@ public:
     virtual void Reset();
     virtual bool Process ( MIDITimedBigMessage *msg );
 
+    // true if Process() lets every event through unchanged, except NoOps
+    bool IsTransparent() const
+    {
+        return !mute && !extra_proc && rechannel == -1 && velocity_scale == 100 && transpose == 0;
+    }
+
+    // true if p has the same settings, so it processes the events like this one
+    bool SameSettings ( const MIDISequencerTrackProcessor &p ) const
+    {
+        return mute == p.mute && solo == p.solo && velocity_scale == p.velocity_scale
+               && rechannel == p.rechannel && transpose == p.transpose && extra_proc == p.extra_proc;
+    }
+
     bool mute;     // track is muted
     bool solo;     // track is solod
     int velocity_scale;   // current velocity scale value for note ons, 100=normal
@@ -233,6 +246,9 @@ public:
     virtual void Reset();
     virtual bool Process ( MIDITimedBigMessage *msg );
 
+    // the state only reads the event, Process() calls this
+    bool ProcessEvent ( const MIDITimedBigMessage *msg );
+
     float tempobpm;    // current tempo in beats per minute
     int pg;      // current program change, or -1
     int volume;     // current volume controller value
@@ -263,15 +279,54 @@ public:
     const MIDIMultiTrack *multitrack;
     int num_tracks;
 
-    MIDISequencerTrackState *track_state[64];
+    // one state per track of the multitrack, at least one, stored contiguously
+    std::vector< MIDISequencerTrackState > track_state;
     MIDIMultiTrackIterator iterator;
     MIDIClockTime cur_clock;
-    float cur_time_ms;
+    double cur_time_ms;
     int cur_beat;
     int cur_measure;
     MIDIClockTime next_beat_time;
 };
 
+///
+/// MIDISequencerCheckpoint is a copy of the sequencer state taken while seeking from time zero,
+/// with the number of events the sequencer had given out since time zero.
+///
+class MIDISequencerCheckpoint
+{
+public:
+    MIDISequencerCheckpoint ( const MIDISequencerState &s, unsigned long num_events_ )
+        : state ( s ), num_events ( num_events_ )
+    {
+    }
+
+    MIDISequencerState state;
+    unsigned long num_events;
+};
+
+///
+/// MIDISequencerEvent is one event given out by MIDISequencer::GetEventsUntil(), with its track.
+/// Like with MIDISequencer::GetNextEventRef(), an event the track processor leaves unchanged
+/// is not copied: the entry points to it in the track.
+///
+class MIDISequencerEvent
+{
+public:
+    MIDISequencerEvent() : track ( 0 ), in_track ( 0 )
+    {
+    }
+
+    const MIDITimedBigMessage &GetMessage() const
+    {
+        return in_track ? *in_track : copy;
+    }
+
+    int track;
+    const MIDITimedBigMessage *in_track; // the event in its track, or 0 for copy
+    MIDITimedBigMessage copy; // the processed event or the beat marker
+};
+
 class MIDISequencer
 {
 public:
@@ -294,6 +349,12 @@ public:
     double GetCurrentTempoScale() const;
     double GetCurrentTempo() const;
 
+    // tempo changes of the conductor track, rebuilt whenever the sequencer goes back to time zero
+    const MIDITempoMap *GetTempoMap() const
+    {
+        return &tempo_map;
+    }
+
     MIDISequencerState *GetState();
     const MIDISequencerState *GetState() const;
 
@@ -315,6 +376,24 @@ public:
     void SetCurrentTempoScale ( float scale );
     void SetSoloMode ( bool m, int trk = -1 );
 
+    ///
+    /// While seeking from time zero, the sequencer keeps a copy of its state every num_events
+    /// events and/or every time_ms milliseconds of song time (0 disables either). Seeks then
+    /// start from the last checkpoint before the target instead of from time zero.
+    /// Checkpoints are off by default: each one holds the states of all tracks, about 2.5 KB
+    /// per track, so choose the interval by the number of tracks and the memory to spare.
+    /// Checkpoints are dropped by this, by SetSoloMode(), ResetTrack() and ResetAllTracks(),
+    /// and by the next seek after the multitrack or the settings of a track processor changed;
+    /// call ClearCheckpoints() after changing what an extra_proc of a track processor does.
+    ///
+    void SetCheckpointInterval ( int num_events, double time_ms = 0. );
+    void ClearCheckpoints();
+
+    int GetNumCheckpoints() const
+    {
+        return ( int ) checkpoints.size();
+    }
+
     void GoToZero();
     bool GoToTime ( MIDIClockTime time_clk );
     bool GoToTimeMs ( float time_ms );
@@ -325,6 +404,25 @@ public:
     bool GetNextEventTime ( MIDIClockTime *t );
     bool GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg );
 
+    ///
+    /// GetNextEventRef() is GetNextEvent() without the copy: *msg points to the event in the
+    /// track, or to a copy made only when the track processor changes or drops the event.
+    /// It is valid until the next call or until the multitrack changes.
+    ///
+    bool GetNextEventRef ( int *tracknum, const MIDITimedBigMessage **msg );
+
+    ///
+    /// GetEventsUntil() gives out in one call every event due at or before time_ms, in ms at
+    /// the current tempo scale, into the first entries of *buffer. The entries are valid until
+    /// the multitrack changes. The buffer grows as needed and is never shrunk, so a reused
+    /// buffer stops allocating once it fits the densest passage. max_events > 0 bounds the
+    /// batch, e.g. by the free space of an output queue, and the remaining events stay for the
+    /// next call. The tempo maths is done once per clock rather than per event, and the
+    /// current time in ms is updated at the end of the batch.
+    /// Returns the number of events given out.
+    ///
+    int GetEventsUntil ( double time_ms, std::vector< MIDISequencerEvent > *buffer, int max_events = 0 );
+
     void ScanEventsAtThisTime();
 
     // end of music is the time of last not end of track midi event!
@@ -332,13 +430,51 @@ public:
 
 protected:
 
+    // rewind the track states, the iterator and the time
+    void ResetToZero();
+
+    // rebuild the tempo map and drop the checkpoints if the multitrack changed since,
+    // drop the checkpoints if the settings of a track processor changed since
+    void SyncToMultiTrack();
+
+    // time of clock t in ms from time zero at the current tempo scale, which must be positive
+    double ScaledMs ( MIDIClockTime t ) const
+    {
+        return tempo_map.TicksToMs ( t ) * ( 100. / tempo_scale );
+    }
+
+    // restore checkpoint n, with the current time in ms recomputed for the current tempo scale
+    void RestoreCheckpoint ( int n );
+
+    // the last checkpoint before clock time_clk, or before measure and beat, or -1
+    int FindCheckpoint ( MIDIClockTime time_clk ) const;
+    int FindCheckpoint ( int measure, int beat ) const;
+
+    // take a checkpoint if one is due, then GetNextEventRef(); for the seeks only
+    bool ReplayNextEvent ( int *tracknum, const MIDITimedBigMessage **msg );
+
+    // advance one event and return it: the track event, the beat marker or *copy processed;
+    // without update_time_ms the caller must set state.cur_time_ms afterwards
+    const MIDITimedBigMessage *NextEvent ( int *tracknum, MIDITimedBigMessage *copy, bool update_time_ms = true );
+
     MIDITimedBigMessage beat_marker_msg;
+    MIDITimedBigMessage event_copy; // the processed copy GetNextEventRef() gives out
 
     bool solo_mode;
     int tempo_scale;
 
     int num_tracks;
-    MIDISequencerTrackProcessor *track_processors[64];
+    std::vector< MIDISequencerTrackProcessor > track_processors;
+
+    MIDITempoMap tempo_map;
+    unsigned long multitrack_version; // of the multitrack the tempo map and checkpoints are for
+
+    std::vector< MIDISequencerCheckpoint > checkpoints;
+    std::vector< MIDISequencerTrackProcessor > checkpoint_processors; // the checkpoints are for
+    int checkpoint_events;
+    double checkpoint_ms;
+    bool replaying;               // true while the state is the one a replay from time zero gives
+    unsigned long replay_events;  // events given out since time zero
 
     MIDISequencerState state;
 } ;
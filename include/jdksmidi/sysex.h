@@ -43,11 +43,22 @@
 namespace jdksmidi
 {
 
+///
+/// The MIDISystemExclusive class holds the variable length data of a sysex, text or meta event.
+/// Data of up to INLINE_SIZE bytes is stored inside the object itself, so short payloads
+/// need no separate data buffer.
+///
+
 class  MIDISystemExclusive
 {
 public:
+    /// chosen to make the whole object 40 bytes on 64 bit systems
+    enum { INLINE_SIZE = 22 };
+
     MIDISystemExclusive ( int size = 384 );
 
+    /// the copy has the capacity of e if e owns a heap buffer, else room for the data of e
+    /// (at least INLINE_SIZE bytes)
     MIDISystemExclusive ( const MIDISystemExclusive &e );
 
 
@@ -65,7 +76,53 @@ public:
         deletable = deletable_;
     }
 
-    virtual ~MIDISystemExclusive();
+    /// take over the data of e, which is left empty
+    MIDISystemExclusive ( MIDISystemExclusive &&e ) noexcept
+    {
+        TakeOver ( e );
+    }
+
+    ~MIDISystemExclusive();
+
+    const MIDISystemExclusive &operator = ( const MIDISystemExclusive &e );
+
+    const MIDISystemExclusive &operator = ( MIDISystemExclusive &&e ) noexcept
+    {
+        if ( this != &e )
+        {
+            if ( deletable )
+                delete [] buf;
+
+            TakeOver ( e );
+        }
+
+        return *this;
+    }
+
+    /// exchange the contents of two objects without copying any heap data
+    void Swap ( MIDISystemExclusive &e )
+    {
+        bool inline1 = ( buf == inline_buf );
+        bool inline2 = ( e.buf == e.inline_buf );
+
+        std::swap ( buf, e.buf );
+        std::swap ( max_len, e.max_len );
+        std::swap ( cur_len, e.cur_len );
+        std::swap ( chk_sum, e.chk_sum );
+        std::swap ( deletable, e.deletable );
+
+        if ( inline1 || inline2 )
+        {
+            std::swap_ranges ( inline_buf, inline_buf + INLINE_SIZE, e.inline_buf );
+
+            // inline data must stay inside its object
+            if ( inline2 )
+                buf = inline_buf;
+
+            if ( inline1 )
+                e.buf = e.inline_buf;
+        }
+    }
 
     friend bool operator == ( const MIDISystemExclusive &e1, const MIDISystemExclusive &e2 );
 
@@ -156,11 +213,43 @@ public:
 
 private:
 
+    // the capacity a copy of this object needs
+    int GetCapacity() const
+    {
+        return deletable ? max_len : cur_len;
+    }
+
+    // move the contents of e to this uninitialized (or released) object and leave e empty
+    void TakeOver ( MIDISystemExclusive &e )
+    {
+        if ( e.buf == e.inline_buf )
+        {
+            buf = inline_buf;
+            memcpy ( inline_buf, e.inline_buf, e.cur_len );
+        }
+        else
+        {
+            buf = e.buf;
+        }
+
+        max_len = e.max_len;
+        cur_len = e.cur_len;
+        chk_sum = e.chk_sum;
+        deletable = e.deletable;
+
+        e.buf = e.inline_buf;
+        e.max_len = 0;
+        e.cur_len = 0;
+        e.chk_sum = 0;
+        e.deletable = false;
+    }
+
     unsigned char *buf;
     int max_len;
     int cur_len;
     unsigned char  chk_sum;
     bool deletable;
+    unsigned char inline_buf[INLINE_SIZE];
 };
 }
 
@@ -163,6 +163,81 @@ protected:
     unsigned long tempo;
 };
 
+class MIDIMultiTrack;
+
+///
+/// MIDITempoMap holds the tempo changes of the conductor track (track 0) of a multitrack as
+/// piecewise linear segments and converts between midi clocks and milliseconds in O(log n).
+/// Each segment keeps the elapsed time at its start in microseconds * clocks per beat, an
+/// integer held exactly by a double for any song shorter than some months, so times do not
+/// drift however long the song is.
+///
+class MIDITempoMap
+{
+public:
+    MIDITempoMap();
+
+    // collect the tempo events of track 0 of mt, it has no events with a null mt
+    void Build ( const MIDIMultiTrack *mt );
+    void Clear();
+
+    int GetDivision() const
+    {
+        return division;
+    }
+
+    int GetNumSegments() const
+    {
+        return ( int ) segments.size();
+    }
+
+    // time of clock t in milliseconds, 0 without a positive division
+    double TicksToMs ( MIDIClockTime t ) const;
+
+    // the first clock at or after time_ms
+    MIDIClockTime MsToTicks ( double time_ms ) const;
+
+    // tempo in effect at clock t, in microseconds per beat
+    unsigned long GetTempoAt ( MIDIClockTime t ) const;
+
+    // tempo in effect at clock t, in beats per minute
+    double GetTempoBPMAt ( MIDIClockTime t ) const
+    {
+        return 60000000. / GetTempoAt ( t );
+    }
+
+    // the tempo in effect after a tempo event of usec microseconds per beat: like the
+    // sequencer, 0 is taken as 1 and tempos below 1 bpm as 120 bpm
+    static unsigned long LimitTempo ( unsigned long usec )
+    {
+        if ( usec == 0 )
+            return 1;
+
+        if ( usec > 60000000 )
+            return 500000;
+
+        return usec;
+    }
+
+private:
+    struct Segment
+    {
+        MIDIClockTime time;        // first clock of the segment
+        unsigned long usec_per_beat;
+        double usec_clocks;        // elapsed time at time, in microseconds * clocks per beat
+    };
+
+    const Segment &FindSegment ( MIDIClockTime t ) const;
+
+    double ToMs ( const Segment &s, MIDIClockTime t ) const
+    {
+        return ( s.usec_clocks + double ( t - s.time ) * s.usec_per_beat ) / ( 1000. * division );
+    }
+
+    int division;
+    std::vector< Segment > segments; // at least one, the first one at clock 0
+};
+
 }
 
 #endif
@@ -46,57 +46,108 @@ namespace jdksmidi
 {
 
 ///
-/// MIDITrackChunkSize is a constant which specifies how many events are in one MIDITrackChunk.
+/// MIDITrackMinimumSize is the number of events a MIDITrack allocates the first time it needs room
+/// for an event. After that the event buffer grows geometrically, so appending is amortized O(1).
 ///
 
-const int MIDITrackChunkSize = 512;
+const int MIDITrackMinimumSize = 64;
 
 
 ///
-/// A MIDITrack's events are allocated in these chunks in order to avoid memory fragmentation
-/// in embedded systems or other systems lacking an MMU. Every item within a MIDITrackChunk
-/// object is a MIDITimedBigMessage. To avoid unnecessary copied of big events, access
-/// to these events is only done via the GetEventAddress() method.
+/// MIDIPayloadArena is a bump allocator for the variable length data (sysex, text and meta payloads)
+/// of the events of one MIDITrack. Memory is taken from large blocks that never move, so a pointer
+/// returned by Allocate() stays valid until Clear(), which frees all blocks at once.
+/// Single allocations cannot be freed.
 ///
 
-class  MIDITrackChunk
+class MIDIPayloadArena
 {
 public:
+    MIDIPayloadArena();
+
+    ~MIDIPayloadArena();
+
     ///
-    /// GetEventAddress() const returns the address of the MIDITimedBigMessage referred to by event_num
-    /// @param event_num an integer specifying an event number in the range 0 to MIDITrackChunkSize
-    /// @returns The const pointer to the requested event.
+    /// Allocate() returns size bytes of storage aligned for any MIDISystemExclusive object
+    /// @returns 0 if the memory could not be allocated
     ///
-    const MIDITimedBigMessage * GetEventAddress ( int event_num ) const;
+    void *Allocate ( int size );
 
     ///
-    /// GetEventAddress()  returns the address of the MIDITimedBigMessage referred to by event_num
-    /// @param event_num an integer specifying an event number in the range 0 to MIDITrackChunkSize
-    /// @returns The non-const pointer to the requested event.
+    /// Clear() frees all the storage of the arena
     ///
+    void Clear();
 
-    MIDITimedBigMessage * GetEventAddress ( int event_num );
+    /// exchange the storage of two arenas
+    void Swap ( MIDIPayloadArena &a )
+    {
+        std::swap ( blocks, a.blocks );
+        std::swap ( heap_size, a.heap_size );
+    }
 
-protected:
+    /// the number of bytes taken from the heap by the arena
+    long GetHeapSize() const
+    {
+        return heap_size;
+    }
 
 private:
-    MIDITimedBigMessage buf[MIDITrackChunkSize];
+
+    // not copyable, the blocks are owned by exactly one arena
+    MIDIPayloadArena ( const MIDIPayloadArena & );
+    const MIDIPayloadArena & operator = ( const MIDIPayloadArena & );
+
+    struct Block
+    {
+        Block *next;
+        int size;
+        int used;
+        // the data follows the header
+    };
+
+    enum
+    {
+        ALIGN = 8,
+        MIN_BLOCK_SIZE = 1024,
+        MAX_BLOCK_SIZE = 64 * 1024
+    };
+
+    Block *NewBlock ( int size );
+
+    Block *blocks; // the current block is the first one
+    long heap_size;
 };
 
+
 ///
-/// The MIDIChunksPerTrack constant specifies the maximum number of MIDITrackChunks that can be in one track.
-/// The value MIDIChunksPerTrack * MIDITrackChunkSize is the total number of events.
-/// This is a constant in order to avoid memory fragmentation in embedded systems or systems without an MMU
+/// MIDITrackChanges counts the changes of a group of tracks, those of a MIDIMultiTrack,
+/// so their owner sees a change of any of them in O(1), see MIDITrack::SetChangeCounter().
 ///
 
-const int MIDIChunksPerTrack = 512;
+class MIDITrackChanges
+{
+public:
+    MIDITrackChanges() : count ( 0 ), unverified ( false )
+    {
+    }
+
+    // grows with the version of every track of the group
+    unsigned long count;
+
+    // set by the non const event accessors of the tracks, their changes are not counted yet
+    bool unverified;
+};
 
 
 ///
-/// The MIDITrack class is a container that manages an array of MIDIChunk objects and provides an
-/// interface to the user that is useful for managing a list of MIDITimedBigMessages. It internally
-/// stores MIDITimedBigMessage objects. There is a fixed maximum number of events that it can store,
-/// which is defined by MIDIChunksPerTrack * MIDITrackChunkSize.
+/// The MIDITrack class is a container that manages a contiguous, growable array of
+/// MIDITimedBigMessage objects and provides an interface to the user that is useful for
+/// managing a list of MIDITimedBigMessages. There is no fixed maximum number of events.
+/// Note that growing the track moves its events, so pointers returned by GetEventAddress()
+/// are only valid until the next PutEvent(), Expand() or Shrink() call.
+/// The sysex, text and meta payloads of the events put into the track are packed into a
+/// MIDIPayloadArena owned by the track, copies of the events taken out of the track own
+/// their payload as usual.
 ///
 
 class  MIDITrack
@@ -116,18 +167,23 @@ public:
     MIDITrack ( const MIDITrack &t );
 
     ///
-    /// The MIDITrack Destructor, frees all chunks and referenced MIDITimedBigMessage's
+    /// Move Constructor, takes over the events and payloads of t, which is left empty
+    ///
+    MIDITrack ( MIDITrack &&t );
+
+    ///
+    /// The MIDITrack Destructor, frees the event buffer and the payloads of all events
     ///
     ~MIDITrack();
 
     ///
-    /// Clear() sets the number of active events in the track to 0. It does NOT
-    /// free any events. See the Shrink() method.
+    /// Clear() removes all events from the track and frees their payloads. It does NOT
+    /// free the event buffer. See the Shrink() method.
     ///
     void Clear();
 
     ///
-    /// Shrink() frees any unused MIDITrackChunk objects and associated MIDITimedBigMessage events.
+    /// Shrink() frees any unused MIDITimedBigMessage events, so the buffer size equals the number of events.
     ///
     void Shrink();
 
@@ -145,11 +201,36 @@ public:
 
     const MIDITrack & operator = ( const MIDITrack & src );
 
-    bool Expand ( int increase_amount = ( MIDITrackChunkSize ) );
+    const MIDITrack & operator = ( MIDITrack && src );
 
-    MIDITimedBigMessage * GetEventAddress ( int event_num );
+    ///
+    /// Expand() enlarges the event buffer by increase_amount events.
+    /// @param increase_amount number of events to add, 0 (the default) doubles the buffer
+    /// @returns false if the memory could not be allocated
+    ///
+    bool Expand ( int increase_amount = 0 );
 
-    const MIDITimedBigMessage * GetEventAddress ( int event_num ) const;
+    ///
+    /// The non const accessors allow changing the event. They only note that the events may
+    /// change: the next time lookup, GetVersion() or SortEventsOrder() checks the time order
+    /// of all events again and counts the access as a change. A pointer kept across such a
+    /// call needs MarkModified() after changing the event. If a change put the events out of
+    /// time order, call SortEventsOrder(), which also restores fast time lookups.
+    ///
+    MIDITimedBigMessage * GetEventAddress ( int event_num )
+    {
+        unverified = true;
+
+        if ( changes )
+            changes->unverified = true;
+
+        return &buf[event_num];
+    }
+
+    const MIDITimedBigMessage * GetEventAddress ( int event_num ) const
+    {
+        return &buf[event_num];
+    }
 
     const MIDITimedBigMessage *GetEvent ( int event_num ) const;
     MIDITimedBigMessage *GetEvent ( int event_num );
@@ -169,6 +250,9 @@ public:
 
     bool PutEvent ( const MIDITimedBigMessage &msg );
 
+    // put event without copying its sysex, msg is left without sysex
+    bool PutEvent ( MIDITimedBigMessage &&msg );
+
     bool PutEvent ( const MIDIDeltaTimedMessage &msg )
     {
         return PutEvent ( MIDIDeltaTimedBigMessage (msg) );
@@ -179,6 +263,7 @@ public:
     // put event and clear msg, exclude its time, keep time unchanged!
     bool PutEvent2 ( MIDITimedBigMessage &msg );
     bool PutEvent ( const MIDITimedMessage &msg, const MIDISystemExclusive *sysex );
+    // note that the payload of the replaced event stays in the payload arena until Clear()
     bool SetEvent ( int event_num, const MIDITimedBigMessage &msg );
 
     // put text message with known length (w/o ending NULL), or evaluate it if zero length
@@ -186,8 +271,44 @@ public:
 
     bool MakeEventNoOp ( int event_num );
 
+    ///
+    /// MarkModified() tells the track that event event_num was changed through a pointer kept
+    /// from an earlier non const access: it grows GetVersion() and, if the time of the event is
+    /// out of order with its neighbours, the events from event_num on are no more known to be
+    /// in time order.
+    ///
+    bool MarkModified ( int event_num );
+
+    ///
+    /// Time lookups. They binary search the events known to be in time order, that is all
+    /// events of a track filled in time order or sorted by SortEventsOrder(), and scan
+    /// the other events linearly.
+    ///
+
+    /// find the first event with time >= time
+    /// @returns false and *event_num = GetNumEvents() if there is no such event
     bool FindEventNumber ( MIDIClockTime time, int *event_num ) const;
 
+    /// find the last event with time < time
+    /// @returns false and *event_num = -1 if there is no such event
+    bool FindLastEventNumberBefore ( MIDIClockTime time, int *event_num ) const;
+
+    /// @returns the number of events with start_time <= time < end_time
+    int GetNumEventsInTimeRange ( MIDIClockTime start_time, MIDIClockTime end_time ) const;
+
+    ///
+    /// SetTimeIndexStep() enables the coarse time index, which holds the time of every step-th
+    /// ordered event, so time lookups touch only a compact table and one run of step events.
+    /// The index follows appends in time order and drops its entries after out of order edits.
+    /// @param step events per index entry, 0 disables the index (the default)
+    ///
+    void SetTimeIndexStep ( int step );
+
+    int GetTimeIndexStep() const
+    {
+        return time_index_step;
+    }
+
     int GetBufferSize() const
     {
         return buf_size;
@@ -207,9 +328,41 @@ public:
         return num_events == 0;
     }
 
+    ///
+    /// GetVersion() grows with every change of the events: by the methods that put, set,
+    /// sort or clear events, by MarkModified(), and once after any number of non const
+    /// accesses to the events.
+    ///
+    unsigned long GetVersion() const
+    {
+        Verify();
+        return version;
+    }
+
+    ///
+    /// SetChangeCounter() makes every change of the track, that grows GetVersion(), count
+    /// in changes too; MIDIMultiTrack does this for its tracks. Copies and moves of the track
+    /// do not take over the counter.
+    /// @param changes_ the counter, 0 for none (the default)
+    ///
+    void SetChangeCounter ( MIDITrackChanges *changes_ )
+    {
+        changes = changes_;
+
+        if ( changes && unverified )
+            changes->unverified = true;
+    }
+
+    MIDITrackChanges *GetChangeCounter() const
+    {
+        return changes;
+    }
+
     // test events temporal order, return false if events out of order
     bool EventsOrderOK() const;
-    // sort events temporal order
+    // sort events temporal order, events with equal times keep their order.
+    // only the events after the first out of order event are sorted, then merged in place.
+    // afterwards all events are known to be in time order again
     void SortEventsOrder();
     // remove events with identical time and all other data, return number of such events
     int RemoveIdenticalEvents( int max_distance_between_identical_events = 32 );
@@ -218,11 +371,57 @@ private:
 
 // void  QSort( int left, int right );
 
-    MIDITrackChunk * chunk[MIDIChunksPerTrack];
+    // move the events to a new buffer of new_size events
+    bool Reallocate ( int new_size );
+
+    // copy the sysex to the payload arena and attach it to the event
+    bool PutPayload ( MIDITimedBigMessage *ev, const MIDISystemExclusive *sysex );
+
+    // after non const accesses to the events, check their time order again from the start
+    void Verify() const
+    {
+        if ( unverified )
+            VerifyEvents();
+    }
+
+    void VerifyEvents() const;
+
+    // extend the ordered events as far as the events are in time order, updating the time index
+    void ExtendOrderedEvents() const;
+
+    // count a change of the events
+    void Changed() const
+    {
+        ++version;
+
+        if ( changes )
+            ++changes->count;
+    }
+
+    // first of the ordered events with time >= time, ordered_events if none
+    int OrderedLowerBound ( MIDIClockTime time ) const;
+
+    MIDITimedBigMessage *buf;
+    MIDIPayloadArena payload;
 
     int buf_size;
     int num_events;
 
+    // incremented by every change of the events, with the change counter if any
+    mutable unsigned long version;
+    MIDITrackChanges *changes;
+
+    // events 0...ordered_events-1 are known to be in time order
+    mutable int ordered_events;
+
+    // set by the non const event accessors, the events may have been changed since
+    mutable bool unverified;
+
+    // time of events 0, step, 2*step... of the ordered events, the first
+    // ( ordered_events + step - 1 ) / step entries are valid
+    int time_index_step;
+    mutable std::vector< MIDIClockTime > time_index;
+
     struct Event_time
     {
         int event_number;
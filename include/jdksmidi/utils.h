@@ -26,6 +26,7 @@
 #define JDKSMIDI_UTILS_H
 
 #include "jdksmidi/multitrack.h"
+#include "jdksmidi/filereadmetadata.h"
 
 namespace jdksmidi
 {
@@ -51,11 +52,26 @@ void CollapseMultiTrack( const MIDIMultiTrack &src, MIDIMultiTrack &dst );
 // midi channel events to tracks 1-16, and all other types of events to track 0
 void CollapseAndExpandMultiTrack( const MIDIMultiTrack &src, MIDIMultiTrack &dst );
 
-bool ReadMidiFile(const char *file, MIDIMultiTrack &dst);
+// if presize_tracks, count the events of each track first and reserve exactly that many
+bool ReadMidiFile(const char *file, MIDIMultiTrack &dst, bool presize_tracks = false);
+
+// read the header, track names, counts, tempo and time signature maps and duration of a midi file,
+// without loading its events
+bool ReadMidiFileMetadata(const char *file, MIDIFileMetadata &dst);
+
+// map midi file to memory and decode its tracks with num_threads threads (0 = one per hardware thread)
+bool ReadMidiFileParallel(const char *file, MIDIMultiTrack &dst, int num_threads = 0);
   
 // write multitrack to midi file; note that src must contain right clks_per_beat value
 bool WriteMidiFile(const MIDIMultiTrack &src, const char *file, bool use_running_status = true);
 
+// write multitrack to midi file, encoding its tracks with num_threads threads (0 = one per hardware thread);
+// the file is identical to the one written by WriteMidiFile()
+bool WriteMidiFileParallel(const MIDIMultiTrack &src, const char *file, int num_threads = 0, bool use_running_status = true);
+
+// write multitrack to midi file image in memory, replacing the contents of dst
+bool WriteMidiFile(const MIDIMultiTrack &src, std::vector<unsigned char> &dst, bool use_running_status = true);
+
 double GetMisicDurationInSeconds(const MIDIMultiTrack &mt);
 
 std::string MultiTrackAsText(const MIDIMultiTrack &mt);
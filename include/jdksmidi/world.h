@@ -42,6 +42,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <new>
+#include <utility>
 #include <string>
 #include <vector>
 #include <algorithm>
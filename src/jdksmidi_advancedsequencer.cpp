@@ -680,7 +680,7 @@ void AdvancedSequencer::ExtractMarkers ( std::vector< std::string > *list )
         return;
     }
 
-    MIDITrack *t = tracks.GetTrack ( 0 );
+    const MIDITrack *t = tracks.GetTrack ( 0 );
     list->clear();
     int cnt = 0;
     int measure = 0;
@@ -693,7 +693,7 @@ void AdvancedSequencer::ExtractMarkers ( std::vector< std::string > *list )
 
     for ( int i = 0; i < t->GetNumEvents(); ++i )
     {
-        MIDITimedBigMessage *m = t->GetEventAddress ( i );
+        const MIDITimedBigMessage *m = t->GetEventAddress ( i );
 
         if ( m )
         {
@@ -781,7 +781,7 @@ int AdvancedSequencer::FindFirstChannelOnTrack ( int trk )
     }
 
     int first_channel = -1;
-    MIDITrack *t = tracks.GetTrack ( trk );
+    const MIDITrack *t = tracks.GetTrack ( trk );
 
     if ( t )
     {
@@ -790,7 +790,7 @@ int AdvancedSequencer::FindFirstChannelOnTrack ( int trk )
         // and then return the channel number plus 1
         for ( int i = 0; i < t->GetNumEvents(); ++i )
         {
-            MIDITimedBigMessage *m = t->GetEventAddress ( i );
+            const MIDITimedBigMessage *m = t->GetEventAddress ( i );
 
             if ( m )
             {
@@ -28,15 +28,17 @@
 namespace jdksmidi
 {
 
-MIDIDriver::MIDIDriver ( int queue_size )
+MIDIDriver::MIDIDriver ( int queue_size, int max_payload )
     :
-    in_queue ( queue_size ),
-    out_queue ( queue_size ),
+    in_queue ( queue_size, max_payload ),
+    out_queue ( queue_size, max_payload ),
+    thru_queue ( queue_size, max_payload ),
     in_proc ( 0 ),
     out_proc ( 0 ),
     thru_proc ( 0 ),
     thru_enable ( false ),
-    tick_proc ( 0 )
+    tick_proc ( 0 ),
+    num_dropped ( 0 )
 {
 }
 
@@ -48,7 +50,22 @@ void MIDIDriver::Reset()
 {
     in_queue.Clear();
     out_queue.Clear();
+    thru_queue.Clear();
     out_matrix.Clear();
+    num_dropped.store ( 0 );
+}
+
+bool MIDIDriver::PutOutput ( const MIDITimedBigMessage &msg )
+{
+    if ( !out_queue.Put ( msg ) )
+    {
+        num_dropped.fetch_add ( 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    // only the notes that really go out
+    out_matrix.Process ( msg );
+    return true;
 }
 
 void MIDIDriver::AllNotesOff ( int chan )
@@ -98,13 +115,9 @@ bool MIDIDriver::HardwareMsgIn ( MIDITimedBigMessage &msg )
 
     // stick input into in queue
 
-    if ( in_queue.CanPut() )
-    {
-        in_queue.Put ( msg );
-    }
-
-    else
+    if ( !in_queue.Put ( msg ) )
     {
+        num_dropped.fetch_add ( 1, std::memory_order_relaxed );
         return false;
     }
 
@@ -121,15 +134,11 @@ bool MIDIDriver::HardwareMsgIn ( MIDITimedBigMessage &msg )
 
     if ( thru_enable )
     {
-        // stick this message into the out queue so the tick procedure
-        // will play it out asap
-        if ( out_queue.CanPut() )
-        {
-            out_queue.Put ( msg );
-        }
-
-        else
+        // stick this message into the thru queue so the tick procedure
+        // will play it out asap; not into the out queue, which has its own producer thread
+        if ( !thru_queue.Put ( msg ) )
         {
+            num_dropped.fetch_add ( 1, std::memory_order_relaxed );
             return false;
         }
     }
@@ -145,25 +154,34 @@ void MIDIDriver::TimeTick ( unsigned long sys_time )
         tick_proc->TimeTick ( sys_time );
     }
 
-    // feed as many midi messages from out_queu to the hardware out port
-    // as we can
+    // feed as many midi messages from thru_queue and out_queue to the hardware
+    // out port as we can, thru messages first
+    if ( SendQueue ( &thru_queue ) )
+    {
+        SendQueue ( &out_queue );
+    }
+}
 
-    while ( out_queue.CanGet() )
+bool MIDIDriver::SendQueue ( MIDIQueue *q )
+{
+    while ( q->CanGet() )
     {
         // use the Peek() function to avoid allocating memory for
         // a duplicate sysex
-        if ( HardwareMsgOut ( * ( out_queue.Peek() ) ) == true )
+        if ( HardwareMsgOut ( * ( q->Peek() ) ) == true )
         {
-            // ok, got and sent a message - update our out_queue now
-            out_queue.Next();
+            // ok, got and sent a message - update our queue now
+            q->Next();
         }
 
         else
         {
             // cant send any more, stop now.
-            break;
+            return false;
         }
     }
+
+    return true;
 }
 
 }
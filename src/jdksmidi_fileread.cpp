@@ -38,6 +38,16 @@
 #include "jdksmidi/world.h"
 #include "jdksmidi/fileread.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 // Standard MIDI-File Format Spec. 1.1, page 9 of 18:
 // "Sysex events and meta events cancel any running status which was in effect.
 // Running status does not apply to and may not be used for these messages."
@@ -48,6 +58,170 @@
 namespace jdksmidi
 {
 
+int MIDIFileReadStream::ReadBlock ( const unsigned char **data )
+{
+    int c = ReadChar();
+
+    if ( c < 0 )
+        return 0;
+
+    one_char = ( unsigned char ) c;
+    *data = &one_char;
+    return 1;
+}
+
+MIDIFileReadStreamFile::MIDIFileReadStreamFile ( const char *fname )
+    : buffer ( new unsigned char [BUFFER_SIZE] ), buffer_pos ( 0 ), buffer_len ( 0 )
+{
+    f = fopen ( fname, "rb" );
+}
+
+#ifdef WIN32
+MIDIFileReadStreamFile::MIDIFileReadStreamFile ( const wchar_t *fname )
+    : buffer ( new unsigned char [BUFFER_SIZE] ), buffer_pos ( 0 ), buffer_len ( 0 )
+{
+    f = _wfopen ( fname, L"rb" );
+}
+#endif
+
+MIDIFileReadStreamFile::MIDIFileReadStreamFile ( FILE *f_ )
+    : f ( f_ ), buffer ( new unsigned char [BUFFER_SIZE] ), buffer_pos ( 0 ), buffer_len ( 0 )
+{
+}
+
+MIDIFileReadStreamFile::~MIDIFileReadStreamFile()
+{
+    if ( f ) fclose ( f );
+    jdks_safe_delete_array( buffer );
+}
+
+void MIDIFileReadStreamFile::Rewind()
+{
+    buffer_pos = 0;
+    buffer_len = 0;
+
+    if ( f ) rewind ( f );
+}
+
+int MIDIFileReadStreamFile::ReadChar()
+{
+    if ( buffer_pos == buffer_len )
+    {
+        const unsigned char *data;
+
+        if ( ReadBlock ( &data ) == 0 )
+            return -1;
+
+        // ReadBlock() handed out the whole buffer, take back all but the first byte
+        buffer_pos = 0;
+    }
+
+    return buffer[buffer_pos++];
+}
+
+int MIDIFileReadStreamFile::ReadBlock ( const unsigned char **data )
+{
+    int n = buffer_len - buffer_pos;
+
+    if ( n == 0 )
+    {
+        buffer_pos = 0;
+        buffer_len = 0;
+
+        if ( !f || feof ( f ) || ferror ( f ) )
+            return 0;
+
+        n = buffer_len = ( int ) fread ( buffer, 1, BUFFER_SIZE, f );
+    }
+
+    *data = buffer + buffer_pos;
+    buffer_pos = buffer_len;
+    return n;
+}
+
+#ifdef WIN32
+
+MIDIFileReadStreamMapped::MIDIFileReadStreamMapped ( const char *fname )
+    : data ( 0 ), length ( 0 ), pos ( 0 )
+{
+    HANDLE file = CreateFileA ( fname, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    Map ( file );
+}
+
+MIDIFileReadStreamMapped::MIDIFileReadStreamMapped ( const wchar_t *fname )
+    : data ( 0 ), length ( 0 ), pos ( 0 )
+{
+    HANDLE file = CreateFileW ( fname, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    Map ( file );
+}
+
+void MIDIFileReadStreamMapped::Map ( void *file )
+{
+    if ( file == INVALID_HANDLE_VALUE )
+        return;
+
+    DWORD size = GetFileSize ( file, 0 );
+
+    if ( size != INVALID_FILE_SIZE && size > 0 )
+    {
+        // copy on write pages, writes do not reach the file
+        HANDLE mapping = CreateFileMapping ( file, 0, PAGE_WRITECOPY, 0, 0, 0 );
+
+        if ( mapping )
+        {
+            data = ( unsigned char * ) MapViewOfFile ( mapping, FILE_MAP_COPY, 0, 0, 0 );
+            length = data ? size : 0;
+            // the view keeps the mapping alive
+            CloseHandle ( mapping );
+        }
+    }
+
+    CloseHandle ( file );
+}
+
+MIDIFileReadStreamMapped::~MIDIFileReadStreamMapped()
+{
+    if ( data ) UnmapViewOfFile ( data );
+}
+
+#else
+
+MIDIFileReadStreamMapped::MIDIFileReadStreamMapped ( const char *fname )
+    : data ( 0 ), length ( 0 ), pos ( 0 )
+{
+    Map ( open ( fname, O_RDONLY ) );
+}
+
+void MIDIFileReadStreamMapped::Map ( int fd )
+{
+    if ( fd < 0 )
+        return;
+
+    struct stat st;
+
+    if ( fstat ( fd, &st ) == 0 && st.st_size > 0 )
+    {
+        // private pages, writes do not reach the file
+        void *p = mmap ( 0, ( size_t ) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+
+        if ( p != MAP_FAILED )
+        {
+            data = ( unsigned char * ) p;
+            length = ( unsigned long ) st.st_size;
+        }
+    }
+
+    // the mapping stays valid after close
+    close ( fd );
+}
+
+MIDIFileReadStreamMapped::~MIDIFileReadStreamMapped()
+{
+    if ( data ) munmap ( data, length );
+}
+
+#endif
+
 void MIDIFileEvents::UpdateTime ( MIDIClockTime delta_time )
 {
 }
@@ -166,6 +340,25 @@ void MIDIFileEvents::mf_header ( int a, int b, int c )
 {
 }
 
+void MIDIFileEvents::mf_trackevents ( int ntrks, const int *num_events )
+{
+}
+
+bool MIDIFileEvents::mf_payload_begin ( MIDIClockTime time, int status, int type, unsigned long len )
+{
+    return true;
+}
+
+bool MIDIFileEvents::mf_payload_continue ( const unsigned char *data, int len )
+{
+    return true;
+}
+
+bool MIDIFileEvents::mf_payload_end ( MIDIClockTime time )
+{
+    return true;
+}
+
 bool MIDIFileEvents::mf_metamisc ( MIDIClockTime time, int a, int b, unsigned char *s )
 {
     return true;
@@ -244,7 +437,11 @@ MIDIFileRead::MIDIFileRead (
 )
     :
     input_stream ( input_stream_ ),
-    event_handler ( event_handler_ )
+    event_handler ( event_handler_ ),
+    cur_pos ( 0 ),
+    end_pos ( 0 ),
+    payloads_in_place ( input_stream_->HasWritableBlocks() ),
+    counting ( false )
 {
     // setup data
     cur_time = 0;
@@ -266,7 +463,9 @@ MIDIFileRead::~MIDIFileRead()
 
 void MIDIFileRead::mf_error ( const char *e )
 {
-    event_handler->mf_error ( e );
+    if ( !counting )
+        event_handler->mf_error ( e );
+
     abort_parse = true;
 }
 
@@ -283,6 +482,8 @@ void MIDIFileRead::Reset()
 
     // rewind input stream
     input_stream->Rewind();
+    cur_pos = 0;
+    end_pos = 0;
 }
 
 int MIDIFileRead::ReadNumTracks()
@@ -291,8 +492,43 @@ int MIDIFileRead::ReadNumTracks()
     return ReadHeader();
 }
 
+bool MIDIFileRead::ParseTrack ( int track_num )
+{
+    Reset();
+    cur_track = track_num;
+    ReadTrack();
+    return !abort_parse;
+}
+
+bool MIDIFileRead::CountTrackEvents ( std::vector< int > *num_events )
+{
+    num_events->clear();
+    counting = true;
+    Reset();
+
+    int n = ReadHeader();
+
+    for ( cur_track = 0; cur_track < n && !abort_parse; cur_track++ )
+        num_events->push_back ( CountEvents() );
+
+    bool ok = ( n > 0 && !abort_parse );
+    counting = false;
+    Reset();
+    return ok;
+}
+
 bool MIDIFileRead::Parse()
 {
+    if ( event_handler->WantTrackEventCounts() )
+    {
+        // a malformed file is reported by the parse itself, with the counts found so far
+        std::vector< int > num_events;
+        CountTrackEvents ( &num_events );
+
+        if ( !num_events.empty() )
+            event_handler->mf_trackevents ( ( int ) num_events.size(), &num_events[0] );
+    }
+
     Reset();
 
     int n = ReadHeader();
@@ -379,32 +615,36 @@ int MIDIFileRead::ReadHeader()
     header_ntrks = ntrks;
 
     header_division = division;
-    event_handler->mf_header ( the_format, ntrks, division );
+
+    if ( !counting )
+        event_handler->mf_header ( the_format, ntrks, division );
+
     // printf( "\nto be read = %d\n", to_be_read );
 
-    while ( to_be_read > 0 )
+    while ( to_be_read > 0 && !abort_parse )
         EGetC();
 
     return ntrks;
 }
 
+//
+// This array is indexed by the high half of a status byte.
+// Its/ value is either the number of bytes needed (1 or 2) for a channel message,
+// or 0 (meaning it's not a channel message).
+//
+static const char chantype[] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0,  // 0x00 through 0x70
+    2, 2, 2, 2, 1, 1, 2, 0   // 0x80 through 0xF0
+};
+
 //
 // read a track chunk
 //
 
 void MIDIFileRead::ReadTrack()
 {
-    //
-    // This array is indexed by the high half of a status byte.
-    // Its/ value is either the number of bytes needed (1 or 2) for a channel message,
-    // or 0 (meaning it's not a channel message).
-    //
-    static char chantype[] =
-    {
-        0, 0, 0, 0, 0, 0, 0, 0,  // 0x00 through 0x70
-        2, 2, 2, 2, 1, 1, 2, 0   // 0x80 through 0xF0
-    };
-    unsigned long lookfor, lng;
+    unsigned long lng;
     int c, c1, type;
     int running = 0; // 1 when running status used
     int status = 0;  // (possible running) status byte
@@ -466,13 +706,23 @@ void MIDIFileRead::ReadTrack()
                 abort_parse = true;
                 break;
             }
-            lookfor = to_be_read - lng;
-            MsgInit();
-            while ( to_be_read > lookfor )
-                MsgAdd ( EGetC() );
+            if ( lng >= ( unsigned long ) max_msg_len && event_handler->WantPayloadChunks() )
+            {
+                if ( !ReadPayloadChunks ( status, type, lng ) )
+                    abort_parse = true;
+                break;
+            }
+            {
+                int len;
+                unsigned char *data = ReadPayload ( lng, &len );
+                // MetaEvent() ends text in NULL, the byte after the payload may be the next event
+                unsigned char next = data[len];
 
-            if ( !event_handler->MetaEvent ( cur_time, type, act_msg_len, the_msg ) )
-                abort_parse = true;
+                if ( !event_handler->MetaEvent ( cur_time, type, len, data ) )
+                    abort_parse = true;
+
+                data[len] = next;
+            }
             break;
 
         case 0xF0: // SYSEX_START
@@ -485,13 +735,19 @@ void MIDIFileRead::ReadTrack()
                 abort_parse = true;
                 break;
             }
-            lookfor = to_be_read - lng;
-            MsgInit();
-            while ( to_be_read > lookfor )
-                MsgAdd ( EGetC() );
+            if ( lng >= ( unsigned long ) max_msg_len && event_handler->WantPayloadChunks() )
+            {
+                if ( !ReadPayloadChunks ( status, type, lng ) )
+                    abort_parse = true;
+                break;
+            }
+            {
+                int len;
+                unsigned char *data = ReadPayload ( lng, &len );
 
-            if ( !event_handler->mf_sysex ( cur_time, type, act_msg_len, the_msg ) )
-                abort_parse = true;
+                if ( !event_handler->mf_sysex ( cur_time, type, len, data ) )
+                    abort_parse = true;
+            }
             break;
 
         default:
@@ -505,6 +761,78 @@ void MIDIFileRead::ReadTrack()
     return;
 }
 
+//
+// count the events of a track chunk, following ReadTrack() byte for byte
+//
+
+int MIDIFileRead::CountEvents()
+{
+    unsigned long lng;
+    int c;
+    int status = 0;
+    int needed;
+    int count = 0;
+
+    if ( !ReadMT ( _MTrk, 0 ) )
+        return 0;
+
+    to_be_read = Read32Bit();
+
+    while ( to_be_read > 0 && !abort_parse )
+    {
+        ReadVariableNum();
+        c = EGetC();
+
+        if ( c == -1 )
+            break;
+
+        if ( ( c & 0x80 ) == 0 )
+        {
+            if ( status == 0 )
+            {
+                mf_error ( "Unexpected Running Status" );
+                break;
+            }
+
+            // the running status data byte is the first byte of the channel message
+            needed = chantype[ ( status>>4 ) & 0x0F ];
+            SkipBytes ( needed > 0 ? needed - 1 : 0 );
+        }
+        else
+        {
+            status = c;
+            needed = chantype[ ( status>>4 ) & 0x0F ];
+            SkipBytes ( needed );
+        }
+
+        if ( !needed )
+        {
+            if ( status == 0xFF ) // META_EVENT
+                EGetC();
+            else if ( status != 0xF0 && status != 0xF7 )
+            {
+                mf_error ( "Unexpected status byte" );
+                break;
+            }
+
+            lng = ReadVariableNum();
+
+            if ( lng > to_be_read )
+            {
+                mf_error ( "Variable length incorrect" );
+                break;
+            }
+
+            SkipBytes ( lng );
+        }
+
+        if ( !abort_parse )
+            ++count;
+    }
+
+    return count;
+}
+
 unsigned long MIDIFileRead::ReadVariableNum()
 {
     unsigned long value;
@@ -525,6 +853,10 @@ unsigned long MIDIFileRead::ReadVariableNum()
         do
         {
             c = EGetC();
+
+            if ( c == -1 )
+                break;
+
             value = ( value << 7 ) + ( c & 0x7f );
         }
         while ( c & 0x80 );
@@ -551,20 +883,131 @@ int MIDIFileRead::Read16Bit()
     return To16Bit ( ( unsigned char ) c1, ( unsigned char ) c2 );
 }
 
-int MIDIFileRead::EGetC()
+int MIDIFileRead::EGetCFromNextBlock()
 {
-    int c;
-    c = input_stream->ReadChar();
+    int n = input_stream->ReadBlock ( &cur_pos );
 
-    if ( c < 0 )
+    if ( n <= 0 )
     {
+        cur_pos = end_pos = 0;
         mf_error ( "Unexpected Stream Error" );
         abort_parse = true;
         return -1;
     }
 
+    end_pos = cur_pos + n;
     --to_be_read;
-    return ( int ) c;
+    return *cur_pos++;
+}
+
+unsigned char *MIDIFileRead::ReadPayload ( unsigned long len, int *payload_len )
+{
+    // in place only if the block holds the payload and the byte after it
+    if ( payloads_in_place && ( unsigned long ) ( end_pos - cur_pos ) > len )
+    {
+        unsigned char *data = const_cast<unsigned char *> ( cur_pos );
+        cur_pos += len;
+        to_be_read -= len;
+        *payload_len = ( int ) len;
+        return data;
+    }
+
+    MsgRead ( len );
+    *payload_len = act_msg_len;
+    return the_msg;
+}
+
+bool MIDIFileRead::ReadPayloadChunks ( int status, int type, unsigned long len )
+{
+    if ( !event_handler->mf_payload_begin ( cur_time, status, type, len ) )
+        return false;
+
+    unsigned long piece_len = ( unsigned long ) ( max_msg_len - 1 );
+
+    while ( len > 0 && !abort_parse )
+    {
+        unsigned long n = ( len < piece_len ) ? len : piece_len;
+        unsigned long in_block = ( unsigned long ) ( end_pos - cur_pos );
+        bool ok;
+
+        if ( in_block > 0 )
+        {
+            // pass the bytes of the current block without copying them
+            if ( n > in_block )
+                n = in_block;
+
+            ok = event_handler->mf_payload_continue ( cur_pos, ( int ) n );
+            cur_pos += n;
+            to_be_read -= n;
+        }
+        else
+        {
+            // let MsgRead() get the next block, or report the end of the stream
+            MsgRead ( n );
+            ok = abort_parse || event_handler->mf_payload_continue ( the_msg, act_msg_len );
+        }
+
+        if ( !ok )
+            return false;
+
+        len -= n;
+    }
+
+    return abort_parse || event_handler->mf_payload_end ( cur_time );
+}
+
+void MIDIFileRead::SkipBytes ( unsigned long len )
+{
+    while ( len > 0 && !abort_parse )
+    {
+        if ( cur_pos == end_pos )
+        {
+            EGetC();
+            --len;
+            continue;
+        }
+
+        unsigned long n = ( unsigned long ) ( end_pos - cur_pos );
+
+        if ( n > len )
+            n = len;
+
+        cur_pos += n;
+        to_be_read -= n;
+        len -= n;
+    }
+}
+
+void MIDIFileRead::MsgRead ( unsigned long len )
+{
+    MsgInit();
+
+    while ( len > 0 && !abort_parse )
+    {
+        if ( cur_pos == end_pos )
+        {
+            // let EGetC() get the next block, or report the end of the stream
+            MsgAdd ( EGetC() );
+            --len;
+            continue;
+        }
+
+        unsigned long n = ( unsigned long ) ( end_pos - cur_pos );
+
+        if ( n > len )
+            n = len;
+
+        unsigned long keep = ( unsigned long ) ( max_msg_len - 1 - act_msg_len );
+
+        if ( keep > n )
+            keep = n;
+
+        memcpy ( the_msg + act_msg_len, cur_pos, keep );
+        act_msg_len += ( int ) keep;
+        cur_pos += n;
+        to_be_read -= n;
+        len -= n;
+    }
 }
 
 void MIDIFileRead::MsgAdd ( int a )
@@ -595,4 +1038,432 @@ bool MIDIFileRead::FormChanMessage ( unsigned char st, unsigned char b1, unsigne
 }
 
 
+// read a variable length number from the n bytes at p, from *pos on,
+// return false if it is incomplete
+static bool PeekVariableNum ( const unsigned char *p, unsigned long n, unsigned long *pos, unsigned long *value )
+{
+    unsigned long v = 0;
+    unsigned long i = *pos;
+
+    do
+    {
+        if ( i >= n )
+            return false;
+
+        v = ( v << 7 ) + ( p[i] & 0x7f );
+    }
+    while ( p[i++] & 0x80 );
+
+    *pos = i;
+    *value = v;
+    return true;
+}
+
+MIDIFileReadIncremental::MIDIFileReadIncremental ( MIDIFileEvents *event_handler_, unsigned long max_msg_len_ )
+    :
+    event_handler ( event_handler_ )
+{
+    max_msg_len = max_msg_len_;
+    the_msg = new unsigned char[max_msg_len];
+    Reset();
+}
+
+MIDIFileReadIncremental::~MIDIFileReadIncremental()
+{
+    jdks_safe_delete_array( the_msg );
+}
+
+void MIDIFileReadIncremental::Reset()
+{
+    state = FIND_HEADER;
+    header_format = 0;
+    header_ntrks = 0;
+    header_division = 0;
+    used_running_status = false;
+    cur_track = 0;
+    cur_time = 0;
+    to_be_read = 0;
+    status = 0;
+    act_msg_len = 0;
+    payload_status = 0;
+    payload_type = 0;
+    payload_left = 0;
+    payload_chunks = false;
+    pending.clear();
+    need_bytes = 0;
+}
+
+bool MIDIFileReadIncremental::Feed ( const void *data_, unsigned long len )
+{
+    const unsigned char *data = static_cast<const unsigned char *> ( data_ );
+
+    // complete the pending unit with just the bytes it needs, the rest is parsed in place
+    while ( len > 0 && !pending.empty() && state != FAILED )
+    {
+        unsigned long take = need_bytes - pending.size();
+
+        if ( take > len )
+            take = len;
+
+        pending.insert ( pending.end(), data, data + take );
+        data += take;
+        len -= take;
+
+        if ( pending.size() < need_bytes )
+            break;
+
+        unsigned long used = ParseUnits ( &pending[0], pending.size() );
+        pending.erase ( pending.begin(), pending.begin() + used );
+    }
+
+    if ( pending.empty() && state != FAILED )
+    {
+        unsigned long used = ParseUnits ( data, len );
+        pending.assign ( data + used, data + len );
+    }
+
+    return state != FAILED;
+}
+
+bool MIDIFileReadIncremental::Finish()
+{
+    if ( state != DONE && state != FAILED )
+        Fail ( "Unexpected Stream Error" );
+
+    pending.clear();
+    return state == DONE;
+}
+
+unsigned long MIDIFileReadIncremental::ParseUnits ( const unsigned char *p, unsigned long n )
+{
+    unsigned long used = 0;
+
+    while ( state != FAILED )
+    {
+        if ( state == DONE )
+            return n;
+
+        State old_state = state;
+        unsigned long r = ParseUnit ( p + used, n - used );
+
+        if ( r == 0 && state == old_state )
+            break;
+
+        used += r;
+    }
+
+    return used;
+}
+
+unsigned long MIDIFileReadIncremental::ParseUnit ( const unsigned char *p, unsigned long n )
+{
+    switch ( state )
+    {
+    case FIND_HEADER:
+    {
+        // like MIDIFileRead::ReadHeader(), skip anything before the MThd chunk
+        unsigned long k = 0;
+
+        while ( k + 4 <= n && memcmp ( p + k, "MThd", 4 ) != 0 )
+            ++k;
+
+        if ( k + 4 <= n && k == 0 )
+        {
+            state = HEADER;
+            return 0;
+        }
+
+        if ( k + 4 > n )
+            k = ( n > 3 ) ? n - 3 : 0;
+
+        need_bytes = 4;
+        return k;
+    }
+
+    case HEADER:
+    {
+        if ( n < 8 )
+        {
+            need_bytes = 8;
+            return 0;
+        }
+
+        unsigned long len = To32Bit ( p[4], p[5], p[6], p[7] );
+
+        if ( len < 6 )
+            len = 6;
+
+        if ( n - 8 < len )
+        {
+            need_bytes = 8 + len;
+            return 0;
+        }
+
+        header_format = To16Bit ( p[8], p[9] );
+        header_ntrks = To16Bit ( p[10], p[11] );
+        header_division = To16Bit ( p[12], p[13] );
+
+        // silently fix error if midi file have format = 0 and ntrks > 1
+        if ( header_format == 0 && header_ntrks > 1 )
+            header_format = 1;
+
+        event_handler->mf_header ( header_format, header_ntrks, header_division );
+        state = TRACK_HEADER;
+
+        if ( header_ntrks <= 0 )
+            Fail ( "No Tracks" );
+
+        return 8 + len;
+    }
+
+    case TRACK_HEADER:
+    {
+        if ( n < 8 )
+        {
+            need_bytes = 8;
+            return 0;
+        }
+
+        if ( memcmp ( p, "MTrk", 4 ) != 0 )
+        {
+            Fail ( "Error looking for chunk type" );
+            return 0;
+        }
+
+        to_be_read = To32Bit ( p[4], p[5], p[6], p[7] );
+        cur_time = 0;
+        status = 0;
+        state = TRACK_EVENTS;
+        event_handler->mf_starttrack ( cur_track );
+
+        if ( to_be_read == 0 )
+            EndTrack();
+
+        return 8;
+    }
+
+    case TRACK_EVENTS:
+    {
+        // the event must end in the chunk
+        unsigned long limit = ( n < to_be_read ) ? n : to_be_read;
+        unsigned long r = ParseEvent ( p, limit );
+
+        if ( r == 0 )
+        {
+            if ( state == TRACK_EVENTS && limit == to_be_read )
+                Fail ( "Event beyond end of track chunk" );
+
+            return 0;
+        }
+
+        to_be_read -= r;
+
+        if ( to_be_read == 0 && state == TRACK_EVENTS )
+            EndTrack();
+
+        return r;
+    }
+
+    case PAYLOAD:
+    {
+        // the payload ends in the chunk, ParseEvent() checked it
+        unsigned long r = ParsePayload ( p, n );
+
+        if ( r == 0 )
+        {
+            need_bytes = 1;
+            return 0;
+        }
+
+        to_be_read -= r;
+
+        if ( to_be_read == 0 && state == TRACK_EVENTS )
+            EndTrack();
+
+        return r;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+unsigned long MIDIFileReadIncremental::ParseEvent ( const unsigned char *p, unsigned long n )
+{
+    unsigned long i = 0;
+    unsigned long deltat;
+    unsigned long lng;
+    int type;
+
+    // an incomplete event needs at least one more byte
+    need_bytes = n + 1;
+
+    if ( !PeekVariableNum ( p, n, &i, &deltat ) || i >= n )
+        return 0;
+
+    int c = p[i++];
+    int st = status;
+    bool running = ( ( c & 0x80 ) == 0 );
+
+    if ( running )
+    {
+        if ( st == 0 )
+        {
+            Fail ( "Unexpected Running Status" );
+            return 0;
+        }
+    }
+    else
+    {
+        st = c;
+    }
+
+    int needed = chantype[ ( st>>4 ) & 0x0F ];
+
+    if ( needed ) // ie. is it a channel message?
+    {
+        if ( n - i < ( unsigned long ) ( running ? needed - 1 : needed ) )
+            return 0;
+
+        MIDITimedMessage m;
+        m.SetStatus ( ( unsigned char ) st );
+        m.SetByte1 ( ( unsigned char ) ( running ? c : p[i++] ) );
+        m.SetByte2 ( ( unsigned char ) ( ( needed > 1 ) ? p[i++] : 0 ) );
+
+        status = st;
+        used_running_status = used_running_status || running;
+        event_handler->UpdateTime ( deltat );
+        cur_time += deltat;
+        m.SetTime ( cur_time );
+
+        if ( !event_handler->ChanMessage ( m ) )
+            Abort();
+
+        return i;
+    }
+
+    // else System Exclusive Event or Meta Event:
+
+    switch ( st )
+    {
+    case 0xFF: // META_EVENT
+        if ( i >= n )
+            return 0;
+
+        type = p[i++];
+        break;
+
+    case 0xF0: // SYSEX_START
+    case 0xF7: // SYSEX_START_A
+        type = st;
+        break;
+
+    default:
+        Fail ( "Unexpected status byte" );
+        return 0;
+    }
+
+    if ( !PeekVariableNum ( p, n, &i, &lng ) )
+        return 0;
+
+    if ( lng > to_be_read - i )
+    {
+        Fail ( "Variable length incorrect" );
+        return 0;
+    }
+
+    status = st;
+    event_handler->UpdateTime ( deltat );
+    cur_time += deltat;
+
+    // the payload is taken by ParsePayload() as it arrives, it is never buffered whole
+    payload_status = st;
+    payload_type = type;
+    payload_left = lng;
+    payload_chunks = lng >= ( unsigned long ) max_msg_len && event_handler->WantPayloadChunks();
+    act_msg_len = 0;
+    state = PAYLOAD;
+
+    if ( payload_chunks && !event_handler->mf_payload_begin ( cur_time, st, type, lng ) )
+    {
+        Abort();
+        return i;
+    }
+
+    if ( lng == 0 )
+        ParsePayload ( p + i, 0 );
+
+    return i;
+}
+
+unsigned long MIDIFileReadIncremental::ParsePayload ( const unsigned char *p, unsigned long n )
+{
+    if ( n > payload_left )
+        n = payload_left;
+
+    bool ok = true;
+
+    if ( payload_chunks )
+    {
+        // pass the bytes without copying them, in pieces of at most max_msg_len-1 bytes
+        unsigned long piece_len = ( unsigned long ) ( max_msg_len - 1 );
+
+        for ( unsigned long k = 0; k < n && ok; k += piece_len )
+        {
+            unsigned long len = ( n - k < piece_len ) ? n - k : piece_len;
+            ok = event_handler->mf_payload_continue ( p + k, ( int ) len );
+        }
+    }
+    else
+    {
+        // keep at most max_msg_len-1 bytes, the last one is for a terminating NULL,
+        // and skip the rest
+        unsigned long room = ( unsigned long ) ( max_msg_len - 1 - act_msg_len );
+        unsigned long len = ( n < room ) ? n : room;
+        memcpy ( the_msg + act_msg_len, p, len );
+        act_msg_len += ( int ) len;
+    }
+
+    payload_left -= n;
+
+    if ( ok && payload_left == 0 )
+    {
+        state = TRACK_EVENTS;
+
+        if ( payload_chunks )
+            ok = event_handler->mf_payload_end ( cur_time );
+        else if ( payload_status == 0xFF )
+            ok = event_handler->MetaEvent ( cur_time, payload_type, act_msg_len, the_msg );
+        else
+            ok = event_handler->mf_sysex ( cur_time, payload_type, act_msg_len, the_msg );
+    }
+
+    if ( !ok )
+        Abort();
+
+    return n;
+}
+
+void MIDIFileReadIncremental::EndTrack()
+{
+    event_handler->mf_endtrack ( cur_track );
+    ++cur_track;
+    state = ( cur_track < header_ntrks ) ? TRACK_HEADER : DONE;
+}
+
+void MIDIFileReadIncremental::Abort()
+{
+    // MIDIFileRead ends the track after an error too
+    if ( state == TRACK_EVENTS || state == PAYLOAD )
+        event_handler->mf_endtrack ( cur_track );
+
+    state = FAILED;
+}
+
+void MIDIFileReadIncremental::Fail ( const char *e )
+{
+    event_handler->mf_error ( e );
+    Abort();
+}
+
 }
@@ -0,0 +1,236 @@
+/*
+ *  libjdksmidi-2004 C++ Class Library for MIDI
+ *
+ *  Copyright (C) 2004  J.D. Koftinoff Software, Ltd.
+ *  www.jdkoftinoff.com
+ *  jeffk@jdkoftinoff.com
+ *
+ *  *** RELEASED UNDER THE GNU GENERAL PUBLIC LICENSE (GPL) April 27, 2004 ***
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "jdksmidi/world.h"
+#include "jdksmidi/filereadmetadata.h"
+
+namespace jdksmidi
+{
+
+MIDIFileMetadata::MIDIFileMetadata()
+{
+    Clear();
+}
+
+void MIDIFileMetadata::Clear()
+{
+    format = 0;
+    num_tracks = 0;
+    division = 0;
+    tempo_map.clear();
+    timesig_map.clear();
+    tracks.clear();
+    num_events = 0;
+    num_notes = 0;
+    channels = 0;
+    duration_ticks = 0;
+    duration_ms = 0.;
+}
+
+double MIDIFileMetadata::TicksToMs ( MIDIClockTime t ) const
+{
+    if ( division & 0x8000 )
+    {
+        // smpte division: frames per second (-24, -25, -29 or -30) and ticks per frame
+        int fps = - ( signed char ) ( division >> 8 );
+        int ticks_per_frame = division & 0xff;
+        double frames_per_sec = ( fps == 29 ) ? 29.97 : fps;
+
+        if ( frames_per_sec <= 0. || ticks_per_frame == 0 )
+            return 0.;
+
+        return t * 1000. / ( frames_per_sec * ticks_per_frame );
+    }
+
+    if ( division <= 0 )
+        return 0.;
+
+    // the tempo change after the last one at or before t
+    size_t lo = 0, hi = tempo_map.size();
+
+    while ( lo < hi )
+    {
+        size_t mid = ( lo + hi ) / 2;
+
+        if ( tempo_map[mid].time <= t )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if ( lo == 0 )
+        return t * ( 500000 * 0.001 ) / division;
+
+    return TicksToMs ( tempo_map[lo - 1], t );
+}
+
+double MIDIFileMetadata::TicksToMs ( const TempoChange &from, MIDIClockTime t ) const
+{
+    if ( division <= 0 || ( division & 0x8000 ) )
+        return TicksToMs ( t );
+
+    return from.time_ms + ( t - from.time ) * ( from.usec_per_beat * 0.001 ) / division;
+}
+
+MIDIFileReadMetadata::MIDIFileReadMetadata ( MIDIFileMetadata *md )
+    : metadata ( md ), track ( 0 ), cur_track ( -1 )
+{
+}
+
+MIDIFileReadMetadata::~MIDIFileReadMetadata()
+{
+}
+
+void MIDIFileReadMetadata::mf_header ( int the_format, int ntrks, int division )
+{
+    metadata->Clear();
+    metadata->format = the_format;
+    metadata->num_tracks = ntrks;
+    metadata->division = division;
+    metadata->tracks.resize ( ntrks );
+}
+
+void MIDIFileReadMetadata::mf_starttrack ( int trk )
+{
+    if ( trk >= ( int ) metadata->tracks.size() )
+        metadata->tracks.resize ( trk + 1 );
+
+    cur_track = trk;
+    track = &metadata->tracks[trk];
+    track->name.clear();
+    track->num_events = 0;
+    track->num_notes = 0;
+    track->channels = 0;
+    track->end_time = 0;
+}
+
+void MIDIFileReadMetadata::mf_endtrack ( int trk )
+{
+    metadata->num_events += track->num_events;
+    metadata->num_notes += track->num_notes;
+    metadata->channels |= track->channels;
+
+    // the tempo map is complete after the first track
+    if ( track->end_time > metadata->duration_ticks )
+        metadata->duration_ticks = track->end_time;
+
+    metadata->duration_ms = metadata->TicksToMs ( metadata->duration_ticks );
+
+    cur_track = -1;
+    track = 0;
+}
+
+bool MIDIFileReadMetadata::ChanMessage ( const MIDITimedMessage &msg )
+{
+    AddEvent ( msg.GetTime() );
+    track->channels |= ( unsigned short ) ( 1 << msg.GetChannel() );
+
+    if ( msg.IsNoteOn() && msg.GetVelocity() > 0 )
+        ++track->num_notes;
+
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_metamisc ( MIDIClockTime time, int type, int len, unsigned char *data )
+{
+    AddEvent ( time );
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_timesig ( MIDIClockTime time, int num, int den_pow, int clks_per_metro, int notated_32nd_per_quarter )
+{
+    AddEvent ( time );
+
+    if ( cur_track == 0 )
+    {
+        MIDIFileMetadata::TimeSigChange ts;
+        ts.time = time;
+        ts.numerator = num;
+        ts.denominator = 1 << ( den_pow & 0x1f );
+        metadata->timesig_map.push_back ( ts );
+    }
+
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_tempo ( MIDIClockTime time, unsigned char a, unsigned char b, unsigned char c )
+{
+    AddEvent ( time );
+
+    if ( cur_track == 0 )
+    {
+        std::vector< MIDIFileMetadata::TempoChange > &tempo_map = metadata->tempo_map;
+        MIDIFileMetadata::TempoChange tc;
+        tc.time = time;
+        tc.usec_per_beat = MIDITempoMap::LimitTempo ( To32Bit ( 0, a, b, c ) );
+
+        // the tempo changes come in time order, go on from the previous one
+        if ( tempo_map.empty() )
+            tc.time_ms = metadata->TicksToMs ( time );
+        else
+            tc.time_ms = metadata->TicksToMs ( tempo_map.back(), time );
+
+        tempo_map.push_back ( tc );
+    }
+
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_keysig ( MIDIClockTime time, int c, int v )
+{
+    AddEvent ( time );
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_sqspecific ( MIDIClockTime time, int len, unsigned char *s )
+{
+    AddEvent ( time );
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_text ( MIDIClockTime time, int type, int len, unsigned char *s )
+{
+    AddEvent ( time );
+
+    // the first name of the track
+    if ( type == MF_META_TRACK_NAME && track->name.empty() )
+        track->name.assign ( ( const char * ) s, len );
+
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_sysex ( MIDIClockTime time, int type, int len, unsigned char *s )
+{
+    AddEvent ( time );
+    return true;
+}
+
+bool MIDIFileReadMetadata::mf_eot ( MIDIClockTime time )
+{
+    // counts as an event, but not for the end time
+    ++track->num_events;
+    return true;
+}
+
+}
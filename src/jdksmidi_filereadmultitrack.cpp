@@ -38,11 +38,14 @@
 #include "jdksmidi/world.h"
 #include "jdksmidi/filereadmultitrack.h"
 
+#include <atomic>
+#include <thread>
+
 namespace jdksmidi
 {
 
-MIDIFileReadMultiTrack::MIDIFileReadMultiTrack ( MIDIMultiTrack *mlttrk )
-    : multitrack ( mlttrk ), cur_track ( -1 )
+MIDIFileReadMultiTrack::MIDIFileReadMultiTrack ( MIDIMultiTrack *mlttrk, bool presize_tracks_ )
+    : multitrack ( mlttrk ), cur_track ( -1 ), presize_tracks ( presize_tracks_ )
 {
 }
 
@@ -86,9 +89,30 @@ void MIDIFileReadMultiTrack::mf_header (int the_format_, int ntrks_, int divisio
     the_format = the_format_;
     num_tracks = ntrks_;
     division = division_;
+
+    // make room for all tracks, when the multitrack was not sized from the file before
+    if ( multitrack->GetNumTracks() < num_tracks )
+        multitrack->ClearAndResize ( num_tracks );
+
     multitrack->SetClksPerBeat ( division );
 }
 
+void MIDIFileReadMultiTrack::mf_trackevents ( int ntrks, const int *num_events )
+{
+    if ( ntrks > multitrack->GetNumTracks() )
+        ntrks = multitrack->GetNumTracks();
+
+    // every event of the file becomes one event of its track
+    for ( int trk = 0; trk < ntrks; ++trk )
+    {
+        MIDITrack *t = multitrack->GetTrack ( trk );
+        int needed = t->GetNumEvents() + num_events[trk];
+
+        if ( needed > t->GetBufferSize() )
+            t->Expand ( needed - t->GetBufferSize() );
+    }
+}
+
 bool MIDIFileReadMultiTrack::ChanMessage ( const MIDITimedMessage &msg )
 {
     return AddEventToMultiTrack ( msg, 0, cur_track );
@@ -173,12 +197,8 @@ bool MIDIFileReadMultiTrack::mf_text ( MIDIClockTime time, int type, int len, un
     msg.SetMetaType ( ( uchar ) type ); // remember - MF_META_* id codes match META_* codes
     msg.SetTime ( time );
 
-    MIDISystemExclusive sysex( len );
-
-    for ( int i = 0; i < len; ++i )
-    {
-        sysex.PutSysByte ( s[i] );
-    }
+    // the track copies the data to its payload arena, so refer to the read buffer
+    MIDISystemExclusive sysex( s, len, len, false );
 
     msg.SetDataLength( 0 ); // variable data length don't saved to data_length
     return AddEventToMultiTrack ( msg, &sysex, cur_track );
@@ -206,12 +226,7 @@ bool MIDIFileReadMultiTrack::mf_sysex ( MIDIClockTime time, int type, int len, u
         msg.SetByte6( s[4] );
 
     msg.SetTime ( time );
-    MIDISystemExclusive sysex( len );
-
-    for ( int i = 0; i < len; ++i )
-    {
-        sysex.PutSysByte ( s[i] );
-    }
+    MIDISystemExclusive sysex( s, len, len, false );
 
    msg.SetDataLength( num );
    return AddEventToMultiTrack ( msg, &sysex, cur_track );
@@ -227,4 +242,273 @@ bool MIDIFileReadMultiTrack::mf_eot ( MIDIClockTime time )
     return AddEventToMultiTrack ( msg, 0, cur_track );
 }
 
+
+// loads one track of MIDIFileReadMultiTrackParallel, keeping its first error
+class MIDIFileReadTrackLoader : public MIDIFileReadMultiTrack
+{
+public:
+    MIDIFileReadTrackLoader ( MIDIMultiTrack *mlttrk, std::string *error_ )
+        : MIDIFileReadMultiTrack ( mlttrk ), error ( error_ )
+    {
+    }
+
+    virtual void mf_error ( const char *e )
+    {
+        if ( error->empty() )
+            *error = e;
+    }
+
+private:
+    std::string *error;
+};
+
+MIDIFileTrackChunks::MIDIFileTrackChunks()
+    :
+    header_format ( 0 ),
+    header_ntrks ( 0 ),
+    header_division ( 0 )
+{
+}
+
+MIDIFileTrackChunks::~MIDIFileTrackChunks()
+{
+}
+
+const char *MIDIFileTrackChunks::GetTrackError ( int trk ) const
+{
+    if ( trk < 0 || trk >= ( int ) track_errors.size() || track_errors[trk].empty() )
+        return 0;
+
+    return track_errors[trk].c_str();
+}
+
+bool MIDIFileTrackChunks::FindChunks (
+    const unsigned char *data,
+    unsigned long length,
+    std::vector< Chunk > *chunks
+)
+{
+    // like MIDIFileRead::ReadHeader(), skip anything before the MThd chunk
+    unsigned long pos = 0;
+
+    while ( pos + 14 <= length && memcmp ( data + pos, "MThd", 4 ) != 0 )
+        ++pos;
+
+    if ( pos + 14 > length )
+        return false;
+
+    unsigned long header_len = MIDIFile::To32Bit ( data[pos+4], data[pos+5], data[pos+6], data[pos+7] );
+
+    if ( header_len < 6 || header_len > length - pos - 8 )
+        return false;
+
+    header_format = MIDIFile::To16Bit ( data[pos+8], data[pos+9] );
+    header_ntrks = MIDIFile::To16Bit ( data[pos+10], data[pos+11] );
+    header_division = MIDIFile::To16Bit ( data[pos+12], data[pos+13] );
+
+    // silently fix error if midi file have format = 0 and ntrks > 1
+    if ( header_format == 0 && header_ntrks > 1 )
+        header_format = 1;
+
+    track_errors.resize ( header_ntrks );
+    pos += 8 + header_len;
+
+    for ( int trk = 0; trk < header_ntrks; ++trk )
+    {
+        Chunk c;
+        c.track_num = trk;
+        c.offset = pos;
+        c.length = length - pos;
+        c.used_running_status = false;
+
+        if ( c.length >= 8 )
+        {
+            if ( memcmp ( data + pos, "MTrk", 4 ) != 0 )
+            {
+                // the serial parser stops here too
+                track_errors[trk] = "Error looking for chunk type";
+                break;
+            }
+
+            unsigned long len = MIDIFile::To32Bit ( data[pos+4], data[pos+5], data[pos+6], data[pos+7] );
+
+            // a chunk cut short by the end of file still gets parsed up to there,
+            // the following ones are empty
+            if ( len < c.length - 8 )
+                c.length = 8 + len;
+
+            pos += c.length;
+        }
+        else
+        {
+            pos = length;
+        }
+
+        chunks->push_back ( c );
+    }
+
+    return true;
+}
+
+void MIDIFileTrackChunks::ParseChunk ( MIDIMultiTrack *multitrack, const unsigned char *data, bool writable, Chunk *c )
+{
+    MIDIFileReadStreamMemory rs ( data + c->offset, c->length, writable );
+    MIDIFileReadTrackLoader loader ( multitrack, &track_errors[c->track_num] );
+    MIDIFileRead reader ( &rs, &loader );
+
+    reader.ParseTrack ( c->track_num );
+    c->used_running_status = reader.UsedRunningStatus();
+}
+
+MIDIFileReadMultiTrackParallel::MIDIFileReadMultiTrackParallel ( MIDIMultiTrack *mlttrk, int num_threads_ )
+    :
+    multitrack ( mlttrk ),
+    num_threads ( num_threads_ ),
+    used_running_status ( false )
+{
+    if ( num_threads <= 0 )
+        num_threads = ( int ) std::thread::hardware_concurrency();
+
+    if ( num_threads <= 0 )
+        num_threads = 1;
+}
+
+MIDIFileReadMultiTrackParallel::~MIDIFileReadMultiTrackParallel()
+{
+}
+
+void MIDIFileReadMultiTrackParallel::ParseChunks (
+    const unsigned char *data,
+    bool writable,
+    std::vector< Chunk > *chunks,
+    void *next_chunk
+)
+{
+    std::atomic<int> *next = static_cast< std::atomic<int> * > ( next_chunk );
+    int i;
+
+    while ( ( i = ( *next )++ ) < ( int ) chunks->size() )
+        ParseChunk ( multitrack, data, writable, &( *chunks ) [i] );
+}
+
+bool MIDIFileReadMultiTrackParallel::Parse ( const void *data_, unsigned long length, bool writable )
+{
+    const unsigned char *data = static_cast<const unsigned char *> ( data_ );
+    std::vector< Chunk > chunks;
+
+    header_format = 0;
+    header_ntrks = 0;
+    header_division = 0;
+    used_running_status = false;
+    track_errors.clear();
+
+    if ( !FindChunks ( data, length, &chunks ) || header_ntrks <= 0 )
+        return false;
+
+    multitrack->ClearAndResize ( header_ntrks );
+    multitrack->SetClksPerBeat ( header_division );
+
+    // the largest chunks first, so the threads finish at about the same time
+    std::stable_sort ( chunks.begin(), chunks.end(), Chunk::larger );
+
+    std::atomic<int> next_chunk ( 0 );
+    int n = std::min ( num_threads, ( int ) chunks.size() );
+    std::vector< std::thread > threads;
+
+    for ( int t = 1; t < n; ++t )
+    {
+        threads.push_back ( std::thread ( &MIDIFileReadMultiTrackParallel::ParseChunks, this,
+                                          data, writable, &chunks, ( void * ) &next_chunk ) );
+    }
+
+    // the calling thread works too
+    ParseChunks ( data, writable, &chunks, &next_chunk );
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+        threads[t].join();
+
+    for ( size_t i = 0; i < chunks.size(); ++i )
+    {
+        if ( chunks[i].used_running_status )
+            used_running_status = true;
+    }
+
+    for ( int trk = 0; trk < header_ntrks; ++trk )
+    {
+        if ( !track_errors[trk].empty() )
+            return false;
+    }
+
+    return true;
+}
+
+MIDIFileReadMultiTrackLazy::MIDIFileReadMultiTrackLazy()
+    :
+    stream ( 0 ),
+    data ( 0 ),
+    multitrack ( 0 )
+{
+}
+
+MIDIFileReadMultiTrackLazy::~MIDIFileReadMultiTrackLazy()
+{
+    // the multitrack may be gone already, so leave it alone
+    jdks_safe_delete_object( stream );
+}
+
+bool MIDIFileReadMultiTrackLazy::Open ( const char *fname, MIDIMultiTrack *mlttrk, int max_loaded_tracks )
+{
+    Close();
+
+    header_format = 0;
+    header_ntrks = 0;
+    header_division = 0;
+    track_errors.clear();
+
+    stream = new MIDIFileReadStreamMapped ( fname );
+
+    if ( !stream->IsValid() )
+    {
+        Close();
+        return false;
+    }
+
+    unsigned long length = stream->ReadBlock ( &data );
+
+    if ( !FindChunks ( data, length, &chunks ) || header_ntrks <= 0 )
+    {
+        Close();
+        return false;
+    }
+
+    multitrack = mlttrk;
+    multitrack->ClearAndResize ( header_ntrks );
+    multitrack->SetClksPerBeat ( header_division );
+    multitrack->SetTrackLoader ( this, max_loaded_tracks );
+    return true;
+}
+
+void MIDIFileReadMultiTrackLazy::Close()
+{
+    if ( multitrack && multitrack->GetTrackLoader() == this )
+        multitrack->SetTrackLoader ( 0 );
+
+    multitrack = 0;
+    chunks.clear();
+    data = 0;
+    jdks_safe_delete_object( stream );
+}
+
+bool MIDIFileReadMultiTrackLazy::LoadTrack ( MIDIMultiTrack *mt, int track_num )
+{
+    if ( track_num >= ( int ) chunks.size() )
+        return track_errors[track_num].empty();
+
+    track_errors[track_num].clear();
+
+    // the mapping is private, so the payloads can be parsed in place
+    ParseChunk ( mt, data, true, &chunks[track_num] );
+    return track_errors[track_num].empty();
+}
+
 }
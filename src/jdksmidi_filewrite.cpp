@@ -58,6 +58,22 @@ MIDIFileWriteStream::~MIDIFileWriteStream()
 {
 }
 
+int MIDIFileWriteStream::WriteBlock ( const unsigned char *data, int len )
+{
+    for ( int i = 0; i < len; ++i )
+    {
+        if ( WriteChar ( data[i] ) < 0 )
+            return -1;
+    }
+
+    return len;
+}
+
+bool MIDIFileWriteStream::IsSeekable()
+{
+    return true;
+}
+
 MIDIFileWriteStreamFile::MIDIFileWriteStreamFile ( FILE *f_ )
     : f ( f_ )
 {
@@ -85,6 +101,65 @@ int MIDIFileWriteStreamFile::WriteChar ( int c )
     }
 }
 
+int MIDIFileWriteStreamFile::WriteBlock ( const unsigned char *data, int len )
+{
+    if ( fwrite ( data, 1, len, f ) != ( size_t ) len )
+        return -1;
+
+    return len;
+}
+
+bool MIDIFileWriteStreamFile::IsSeekable()
+{
+    // fails on pipes, sockets and terminals
+    return f != 0 && fseek ( f, 0, SEEK_CUR ) == 0;
+}
+
+MIDIFileWriteStreamMemory::MIDIFileWriteStreamMemory()
+    : pos ( 0 )
+{
+}
+
+MIDIFileWriteStreamMemory::~MIDIFileWriteStreamMemory()
+{
+}
+
+long MIDIFileWriteStreamMemory::Seek ( long offset, int whence )
+{
+    long base = 0;
+
+    if ( whence == SEEK_CUR )
+        base = ( long ) pos;
+    else if ( whence == SEEK_END )
+        base = ( long ) data.size();
+
+    if ( base + offset < 0 )
+        return -1;
+
+    // like fseek(), seeking beyond the end is allowed, the gap is filled by the next write
+    pos = ( unsigned long ) ( base + offset );
+    return 0;
+}
+
+int MIDIFileWriteStreamMemory::WriteChar ( int c )
+{
+    unsigned char b = ( unsigned char ) c;
+    return ( WriteBlock ( &b, 1 ) < 0 ) ? -1 : 0;
+}
+
+int MIDIFileWriteStreamMemory::WriteBlock ( const unsigned char *block, int len )
+{
+    if ( len <= 0 )
+        return len;
+
+    if ( pos + len > data.size() )
+        data.resize ( pos + len );
+
+    memcpy ( &data[pos], block, len );
+    pos += len;
+    return len;
+}
+
 
 MIDIFileWrite::MIDIFileWrite ( MIDIFileWriteStream *out_stream_ )
     : out_stream ( out_stream_ )
@@ -97,11 +172,72 @@ MIDIFileWrite::MIDIFileWrite ( MIDIFileWriteStream *out_stream_ )
     running_status = 0;
     track_position = 0;
     use_running_status = true;
+    forward_only = !out_stream->IsSeekable();
+    track_header_pos = -1;
+    buffer = new unsigned char [BUFFER_SIZE];
+    buffer_len = 0;
+    buffer_size = BUFFER_SIZE;
 }
 
 MIDIFileWrite::~MIDIFileWrite()
 {
     ENTER ( "MIDIFileWrite::~MIDIFileWrite()" );
+    Flush();
+    jdks_safe_delete_array( buffer );
+}
+
+bool MIDIFileWrite::Flush()
+{
+    int len = ( track_header_pos >= 0 ) ? track_header_pos : buffer_len;
+
+    if ( len > 0 )
+    {
+        if ( out_stream->WriteBlock ( buffer, len ) != len )
+            error = true;
+
+        // keep the pending track at the start of the buffer
+        memmove ( buffer, buffer + len, buffer_len - len );
+        buffer_len -= len;
+
+        if ( track_header_pos >= 0 )
+            track_header_pos = 0;
+    }
+
+    return !error;
+}
+
+void MIDIFileWrite::Overflow()
+{
+    Flush();
+
+    if ( buffer_len < buffer_size )
+        return;
+
+    // the buffer is full of a pending track: grow it
+    unsigned char *new_buffer = new unsigned char [buffer_size * 2];
+    memcpy ( new_buffer, buffer, buffer_len );
+    jdks_safe_delete_array( buffer );
+    buffer = new_buffer;
+    buffer_size *= 2;
+}
+
+void MIDIFileWrite::WriteBytes ( const unsigned char *data, unsigned long len )
+{
+    while ( len > 0 )
+    {
+        if ( buffer_len == buffer_size )
+            Overflow();
+
+        unsigned long n = buffer_size - buffer_len;
+
+        if ( n > len )
+            n = len;
+
+        memcpy ( buffer + buffer_len, data, n );
+        buffer_len += ( int ) n;
+        data += n;
+        len -= n;
+    }
 }
 
 void MIDIFileWrite::Error ( const char *s )
@@ -156,6 +292,15 @@ void MIDIFileWrite::WriteFileHeader (
 void MIDIFileWrite::WriteTrackHeader ( unsigned long length )
 {
     ENTER ( "void MIDIFileWrite::WriteTrackHeader()" );
+
+    if ( forward_only )
+    {
+        // send what precedes the track now, and hold the track until its length is known
+        track_header_pos = -1;
+        Flush();
+        track_header_pos = buffer_len;
+    }
+
     track_position = file_length;
     track_length = 0;
     track_time = 0;
@@ -307,10 +452,7 @@ void MIDIFileWrite::WriteSystemExclusiveEvent ( const MIDITimedBigMessage &m )
     int len = m.GetSysEx()->GetLengthSE();
     IncrementCounters ( WriteVariableNum ( len ) );
 
-    for ( int i = 0; i < len; i++ )
-    {
-        WriteCharacter ( m.GetSysEx()->GetData ( i ) );
-    }
+    WriteBytes ( m.GetSysEx()->GetBuf(), len );
     IncrementCounters ( len );
 
     running_status = 0;
@@ -328,10 +470,7 @@ void MIDIFileWrite::WriteTextEvent ( unsigned long time, unsigned char type, con
     int len = strlen ( text );
     IncrementCounters ( WriteVariableNum ( len ) );
 
-    while ( *text )
-    {
-        WriteCharacter ( ( unsigned char ) *text++ );
-    }
+    WriteBytes ( ( const unsigned char * ) text, len );
     IncrementCounters ( len );
 
     running_status = 0;
@@ -348,10 +487,8 @@ void MIDIFileWrite::WriteMetaEvent ( unsigned long time, unsigned char type, con
 
     IncrementCounters ( WriteVariableNum ( length ) );
 
-    for ( int i = 0; i < length; i++ )
-    {
-        WriteCharacter ( data[i] );
-    }
+    if ( length > 0 )
+        WriteBytes ( data, length );
 
     IncrementCounters ( length );
     running_status = 0;
@@ -470,6 +607,23 @@ void MIDIFileWrite::RewriteTrackLength()
     // go back and patch in the tracks length into the track chunk
     // header, now that we know the proper value.
     // then make sure we go back to the end of the file
+    if ( forward_only )
+    {
+        // the track is still in the buffer, patch it there
+        if ( track_header_pos >= 0 )
+        {
+            unsigned char *p = buffer + track_header_pos + 4;
+            p[0] = ( unsigned char ) ( ( track_length >> 24 ) & 0xff );
+            p[1] = ( unsigned char ) ( ( track_length >> 16 ) & 0xff );
+            p[2] = ( unsigned char ) ( ( track_length >> 8 ) & 0xff );
+            p[3] = ( unsigned char ) ( track_length & 0xff );
+            track_header_pos = -1;
+            Flush();
+        }
+
+        return;
+    }
+
     Seek ( track_position + 4 );
     WriteLong ( track_length );
     Seek ( track_position + 8 + track_length );
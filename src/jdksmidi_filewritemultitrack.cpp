@@ -29,17 +29,29 @@
 #include "jdksmidi/world.h"
 #include "jdksmidi/filewritemultitrack.h"
 
+#include <algorithm>
+#include <thread>
+
 namespace jdksmidi
 {
 
 MIDIFileWriteMultiTrack::MIDIFileWriteMultiTrack (
     const MIDIMultiTrack *mlt_,
-    MIDIFileWriteStream *strm_
+    MIDIFileWriteStream *strm_,
+    int num_threads_
 )
     :
     multitrack ( mlt_ ),
-    writer ( strm_ )
+    stream ( strm_ ),
+    writer ( strm_ ),
+    num_threads ( num_threads_ ),
+    use_running_status ( true )
 {
+    if ( num_threads <= 0 )
+        num_threads = ( int ) std::thread::hardware_concurrency();
+
+    if ( num_threads <= 0 )
+        num_threads = 1;
 }
 
 MIDIFileWriteMultiTrack::~MIDIFileWriteMultiTrack()
@@ -53,50 +65,140 @@ bool MIDIFileWriteMultiTrack::Write ( int num_tracks, int division )
 
     // first, write the header.
     writer.WriteFileHeader ( ( num_tracks > 1 )? 1:0, num_tracks, division );
-    // now write each track
 
-    for ( int i = 0; i < num_tracks; ++i )
+    // now write each track; tracks loaded on demand are not thread safe, write them serially
+    if ( num_threads > 1 && num_tracks > 1 && !multitrack->GetTrackLoader() )
+    {
+        if ( !WriteTracksParallel ( num_tracks ) )
+            return false;
+    }
+    else
     {
-        const MIDITrack *t = multitrack->GetTrack ( i );
+        for ( int i = 0; i < num_tracks; ++i )
+        {
+            if ( !WriteTrack ( &writer, multitrack->GetTrack ( i ) ) )
+                return false;
+        }
+    }
+
+    if ( !writer.Flush() )
+        return false;
+
+    if ( !PostWrite() )
+        return false;
 
-        if ( !t || !t->EventsOrderOK() ) // time of events out of order: t->SortEventsOrder() must be done externally
+    return true;
+}
+
+bool MIDIFileWriteMultiTrack::WriteTrack ( MIDIFileWrite *w, const MIDITrack *t )
+{
+    if ( !t || !t->EventsOrderOK() ) // time of events out of order: t->SortEventsOrder() must be done externally
+        return false;
+
+    w->WriteTrackHeader ( 0 ); // will be rewritten later
+
+    const MIDITimedBigMessage *ev;
+    MIDIClockTime ev_time = 0;
+
+    for ( int event_num = 0; event_num < t->GetNumEvents(); ++event_num )
+    {
+        ev = t->GetEventAddress ( event_num );
+        if ( !ev )
             return false;
 
-        writer.WriteTrackHeader ( 0 ); // will be rewritten later
+        // don't write to midifile NoOp msgs
+        if ( ev->IsNoOp() )
+            continue;
 
-        const MIDITimedBigMessage *ev;
-        MIDIClockTime ev_time = 0;
+        ev_time = ev->GetTime();
 
-        for ( int event_num = 0; event_num < t->GetNumEvents(); ++event_num )
-        {
-            ev = t->GetEventAddress ( event_num );
-            if ( !ev )
-                return false;
+        // ignore all msgs after EndOfTrack
+        if ( ev->IsDataEnd() )
+          break;
+
+        // write all other msgs
+        w->WriteEvent ( *ev );
+
+        if ( w->ErrorOccurred() )
+            return false;
+    }
 
-            // don't write to midifile NoOp msgs
-            if ( ev->IsNoOp() )
-                continue;
+    w->WriteEndOfTrack ( ev_time );
+    w->RewriteTrackLength();
+    return !w->ErrorOccurred();
+}
 
-            ev_time = ev->GetTime();
+struct MIDIFileWriteMultiTrack::TrackJob
+{
+    const MIDITrack *track;
+    MIDIFileWriteStreamMemory out;
+    bool ok;
 
-            // ignore all msgs after EndOfTrack
-            if ( ev->IsDataEnd() )
-              break;
+    static bool larger ( const TrackJob *a, const TrackJob *b )
+    {
+        return a->track->GetNumEvents() > b->track->GetNumEvents();
+    }
+};
 
-            // write all other msgs
-            writer.WriteEvent ( *ev );
+void MIDIFileWriteMultiTrack::EncodeTracks ( std::vector< TrackJob * > *jobs, std::atomic<int> *next_job )
+{
+    int i;
 
-            if ( writer.ErrorOccurred() )
-                return false;
-        }
+    while ( ( i = ( *next_job )++ ) < ( int ) jobs->size() )
+    {
+        TrackJob *job = ( *jobs ) [i];
+        MIDIFileWrite w ( &job->out );
+        w.UseRunningStatus ( use_running_status );
+        job->ok = WriteTrack ( &w, job->track ) && w.Flush();
+    }
+}
+
+bool MIDIFileWriteMultiTrack::WriteTracksParallel ( int num_tracks )
+{
+    std::vector< TrackJob > jobs ( num_tracks );
+    std::vector< TrackJob * > order ( num_tracks );
+
+    for ( int i = 0; i < num_tracks; ++i )
+    {
+        jobs[i].track = multitrack->GetTrack ( i );
+        jobs[i].ok = false;
+        order[i] = &jobs[i];
 
-        writer.WriteEndOfTrack ( ev_time );
-        writer.RewriteTrackLength();
+        if ( !jobs[i].track || !jobs[i].track->EventsOrderOK() )
+            return false;
     }
 
-    if ( !PostWrite() )
+    // the largest tracks first, so the threads finish at about the same time
+    std::stable_sort ( order.begin(), order.end(), TrackJob::larger );
+
+    std::atomic<int> next_job ( 0 );
+    int n = std::min ( num_threads, num_tracks );
+    std::vector< std::thread > threads;
+
+    for ( int t = 1; t < n; ++t )
+    {
+        threads.push_back ( std::thread ( &MIDIFileWriteMultiTrack::EncodeTracks, this,
+                                          &order, &next_job ) );
+    }
+
+    // the calling thread works too
+    EncodeTracks ( &order, &next_job );
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+        threads[t].join();
+
+    // the header is still in the writer buffer, the tracks go behind it in file order
+    if ( !writer.Flush() )
         return false;
 
+    for ( int i = 0; i < num_tracks; ++i )
+    {
+        int len = ( int ) jobs[i].out.GetLength();
+
+        if ( !jobs[i].ok || stream->WriteBlock ( jobs[i].out.GetData(), len ) != len )
+            return false;
+    }
+
     return true;
 }
 
@@ -194,8 +194,6 @@ void MIDIManager::TimeTickPlayMode ( unsigned long sys_time_ )
 {
     double sys_time = ( double ) sys_time_ - ( double ) sys_time_offset;
     float next_event_time = 0.0;
-    int ev_track;
-    MIDITimedBigMessage ev;
 
     // if we are in repeat mode, repeat if we hit end of the repeat region
     if ( repeat_play_mode &&
@@ -214,21 +212,19 @@ void MIDIManager::TimeTickPlayMode ( unsigned long sys_time_ )
         seq_time_offset = ( unsigned long ) sequencer->GetCurrentTimeInMs();
     }
 
-    // find all events that exist before or at this time,
-    // but only if we have space in the output queue to do so!
-    // also limit ourselves to 100 midi events max.
-    int output_count = 100;
+    // find all events that exist before or at this time in one batch,
+    // but only as many as we have space for in the output queue!
+    int output_space = driver->GetOutputSpace();
 
-    while ( sequencer->GetNextEventTimeMs ( &next_event_time ) &&
-            ( next_event_time - seq_time_offset ) <= sys_time  &&
-            driver->CanOutputMessage() &&
-            ( --output_count ) > 0 )
+    if ( output_space > 0 )
     {
-        // found an event! get it!
-        if ( sequencer->GetNextEvent ( &ev_track, &ev ) )
+        int num_events = sequencer->GetEventsUntil (
+                             sys_time + seq_time_offset, &play_events, output_space );
+
+        // ok, tell the driver the send these messages now
+        for ( int i = 0; i < num_events; ++i )
         {
-            // ok, tell the driver the send this message now
-            driver->OutputMessage ( ev );
+            driver->OutputMessage ( play_events[i].GetMessage() );
         }
     }
 
@@ -743,6 +743,7 @@ void MIDIMessage::SetUserAppMarker()
 
 MIDIBigMessage::MIDIBigMessage()
     :
+    sysex_attached ( false ),
     sysex ( 0 )
 {
 }
@@ -750,6 +751,7 @@ MIDIBigMessage::MIDIBigMessage()
 MIDIBigMessage::MIDIBigMessage ( const MIDIBigMessage &m )
     :
     MIDIMessage ( m ),
+    sysex_attached ( false ),
     sysex ( 0 )
 {
     if ( m.sysex )
@@ -761,6 +763,7 @@ MIDIBigMessage::MIDIBigMessage ( const MIDIBigMessage &m )
 MIDIBigMessage::MIDIBigMessage ( const MIDIMessage &m )
     :
     MIDIMessage ( m ),
+    sysex_attached ( false ),
     sysex ( 0 )
 {
 }
@@ -768,6 +771,7 @@ MIDIBigMessage::MIDIBigMessage ( const MIDIMessage &m )
 MIDIBigMessage::MIDIBigMessage ( const MIDIMessage &m, const MIDISystemExclusive *e )
     :
     MIDIMessage ( m ),
+    sysex_attached ( false ),
     sysex ( 0 )
 {
     CopySysEx( e );
@@ -794,10 +798,10 @@ MIDIBigMessage::~MIDIBigMessage()
 
 const MIDIBigMessage &MIDIBigMessage::operator = ( const MIDIBigMessage &m )
 {
-    delete sysex;
-    sysex = 0;
-    if ( m.sysex )
-        sysex = new MIDISystemExclusive ( *m.sysex );
+    if ( this == &m )
+        return *this;
+
+    CopySysEx ( m.sysex );
 
     MIDIMessage::operator = ( m );
     return *this;
@@ -805,8 +809,7 @@ const MIDIBigMessage &MIDIBigMessage::operator = ( const MIDIBigMessage &m )
 
 const MIDIBigMessage &MIDIBigMessage::operator = ( const MIDIMessage &m )
 {
-    delete sysex;
-    sysex = 0;
+    ClearSysEx();
     MIDIMessage::operator = ( m );
     return *this;
 }
@@ -841,6 +844,16 @@ const MIDISystemExclusive *MIDIBigMessage::GetSysEx() const
 
 void MIDIBigMessage::CopySysEx ( const MIDISystemExclusive *e )
 {
+    if ( e == sysex )
+        return;
+
+    if ( e && sysex && !sysex_attached )
+    {
+        // reuse our own sysex, this allocates only if its buffer is too small
+        *sysex = *e;
+        return;
+    }
+
     ClearSysEx();
     if ( e )
     {
@@ -856,9 +869,25 @@ void MIDIBigMessage::SetSysEx ( MIDISystemExclusive *e )
 }
 #endif
 
+void MIDIBigMessage::AttachSysEx ( MIDISystemExclusive *e )
+{
+    ClearSysEx();
+    sysex = e;
+    sysex_attached = ( e != 0 );
+}
+
 void MIDIBigMessage::ClearSysEx()
 {
-    jdks_safe_delete_object( sysex );
+    if ( sysex_attached )
+    {
+        // not ours, just forget it
+        sysex = 0;
+        sysex_attached = false;
+    }
+    else
+    {
+        jdks_safe_delete_object( sysex );
+    }
 }
 
 
@@ -37,6 +37,7 @@
 
 #include "jdksmidi/world.h"
 #include "jdksmidi/multitrack.h"
+#include "jdksmidi/tempo.h"
 
 #ifndef DEBUG_MDMLTTRK
 # define DEBUG_MDMLTTRK 0
@@ -54,12 +55,74 @@ MIDIMultiTrack::MIDIMultiTrack ( int num_tracks_, bool deletable_ )
 {
     ENTER ( "MIDIMultiTrack::MIDIMultiTrack()" );
     clks_per_beat = 0;
+    version = 0;
+    statistics_version = 0;
+    statistics_valid = false;
     tracks = 0; // object still don't exist
+    track_use = 0;
+    load_changes = 0;
+    track_loaded_version = 0;
     CreateObject ( num_tracks_, deletable_ );
 }
 
+MIDIMultiTrack::MIDIMultiTrack ( MIDIMultiTrack &&mt )
+{
+    clks_per_beat = mt.clks_per_beat;
+    version = mt.version;
+    statistics = mt.statistics;
+    statistics_version = mt.statistics_version;
+    statistics_valid = mt.statistics_valid;
+    tracks = mt.tracks;
+    number_of_tracks = mt.number_of_tracks;
+    deletable = mt.deletable;
+    track_loader = mt.track_loader;
+    max_loaded_tracks = mt.max_loaded_tracks;
+    num_loaded_tracks = mt.num_loaded_tracks;
+    track_use = mt.track_use;
+    track_changes = mt.track_changes;
+    load_changes = mt.load_changes;
+    track_loaded_version = mt.track_loaded_version;
+    use_count = mt.use_count;
+    AttachTracks();
+
+    unsigned long mt_version = mt.GetVersion();
+    mt.tracks = 0;
+    mt.number_of_tracks = 0;
+    mt.track_loader = 0;
+    mt.track_use = 0;
+    mt.track_loaded_version = 0;
+    mt.TracksReplaced ( mt_version );
+}
+
+const MIDIMultiTrack & MIDIMultiTrack::operator = ( MIDIMultiTrack &&mt )
+{
+    unsigned long old_version = GetVersion();
+    unsigned long mt_version = mt.GetVersion();
+
+    // mt gets our old tracks and deletes them
+    std::swap ( tracks, mt.tracks );
+    std::swap ( number_of_tracks, mt.number_of_tracks );
+    std::swap ( deletable, mt.deletable );
+    std::swap ( track_loader, mt.track_loader );
+    std::swap ( max_loaded_tracks, mt.max_loaded_tracks );
+    std::swap ( num_loaded_tracks, mt.num_loaded_tracks );
+    std::swap ( track_use, mt.track_use );
+    std::swap ( track_changes, mt.track_changes );
+    std::swap ( load_changes, mt.load_changes );
+    std::swap ( track_loaded_version, mt.track_loaded_version );
+    std::swap ( use_count, mt.use_count );
+    AttachTracks();
+    mt.AttachTracks();
+    clks_per_beat = mt.clks_per_beat;
+    TracksReplaced ( old_version );
+    mt.TracksReplaced ( mt_version );
+    return *this;
+}
+
 bool MIDIMultiTrack::CreateObject ( int num_tracks_, bool deletable_ )
 {
+    unsigned long old_version = GetVersion();
+
     // delete old multitrack object
     if ( tracks )
         this->~MIDIMultiTrack();
@@ -67,6 +130,12 @@ bool MIDIMultiTrack::CreateObject ( int num_tracks_, bool deletable_ )
     number_of_tracks = num_tracks_;
     deletable = deletable_;
 
+    // the new tracks are not loaded lazily
+    track_loader = 0;
+    max_loaded_tracks = 0;
+    num_loaded_tracks = 0;
+    use_count = 0;
+
     tracks = new MIDITrack * [number_of_tracks];
     if ( !tracks )
         return false;
@@ -77,6 +146,7 @@ bool MIDIMultiTrack::CreateObject ( int num_tracks_, bool deletable_ )
         {
             tracks[i] = new MIDITrack;
             if ( !tracks[i] ) return false;
+            tracks[i]->SetChangeCounter ( &track_changes );
         }
     }
     else
@@ -85,6 +155,7 @@ bool MIDIMultiTrack::CreateObject ( int num_tracks_, bool deletable_ )
             tracks[i] = 0;
     }
 
+    TracksReplaced ( old_version );
     return true;
 }
 
@@ -95,23 +166,40 @@ bool MIDIMultiTrack::ClearAndResize ( int num_tracks )
 
 bool MIDIMultiTrack::AssignEventsToTracks ( const MIDITrack *src )
 {
-    MIDITrack tmp( *src ); // make copy of src track
+    MIDITrack tmp;
+
+    for ( int i = 0; i < number_of_tracks; ++i )
+    {
+        if ( deletable && tracks[i] == src )
+        {
+            // src is deleted below, take over its events
+            tmp = std::move ( *tracks[i] );
+            src = &tmp;
+            break;
+        }
+    }
 
     // renew multitrack object with 17 tracks:
     // tracks 1-16 for channel events, and track 0 for other types of events
     ClearAndResize( 17 );
 
     // move events to tracks 0-16 according it's types/channels
-    for ( int i = 0; i < tmp.GetNumEvents(); ++i )
+    for ( int i = 0; i < src->GetNumEvents(); ++i )
     {
         const MIDITimedBigMessage *msg;
-        msg = tmp.GetEventAddress ( i );
+        msg = src->GetEventAddress ( i );
 
         int track_num = 0;
         if ( msg->IsChannelMsg() )
             track_num = 1 + msg->GetChannel();
 
-        if ( !GetTrack ( track_num )->PutEvent( *msg ) )
+        bool ok;
+        if ( src == &tmp )
+            ok = GetTrack ( track_num )->PutEvent( std::move ( *tmp.GetEventAddress ( i ) ) );
+        else
+            ok = GetTrack ( track_num )->PutEvent( *msg );
+
+        if ( !ok )
             return false;
     }
 
@@ -122,6 +210,9 @@ MIDIMultiTrack::~MIDIMultiTrack()
 {
     ENTER ( "MIDIMultiTrack::~MIDIMultiTrack()" );
 
+    // tracks not deleted here must not count their changes in this multitrack any more
+    DetachTracks();
+
     if ( deletable )
     {
         for ( int i = 0; i < number_of_tracks; ++i )
@@ -131,47 +222,233 @@ MIDIMultiTrack::~MIDIMultiTrack()
     }
 
     jdks_safe_delete_array( tracks );
+    jdks_safe_delete_array( track_use );
+    jdks_safe_delete_array( track_loaded_version );
+}
+
+void MIDIMultiTrack::SetTrack ( int track_num, MIDITrack *track )
+{
+    unsigned long old_version = GetVersion();
+
+    if ( tracks[track_num] && tracks[track_num]->GetChangeCounter() == &track_changes )
+        tracks[track_num]->SetChangeCounter ( 0 );
+
+    tracks[track_num] = track;
+
+    if ( track )
+        track->SetChangeCounter ( &track_changes );
+
+    TracksReplaced ( old_version );
+}
+
+void MIDIMultiTrack::AttachTracks()
+{
+    for ( int i = 0; i < number_of_tracks; ++i )
+    {
+        if ( tracks[i] )
+            tracks[i]->SetChangeCounter ( &track_changes );
+    }
+}
+
+void MIDIMultiTrack::DetachTracks()
+{
+    for ( int i = 0; i < number_of_tracks; ++i )
+    {
+        if ( tracks[i] && tracks[i]->GetChangeCounter() == &track_changes )
+            tracks[i]->SetChangeCounter ( 0 );
+    }
 }
 
 void MIDIMultiTrack::Clear()
 {
+    // the cleared tracks stay empty
+    SetTrackLoader ( 0 );
+
     for ( int i = 0; i < number_of_tracks; ++i )
     {
         tracks[i]->Clear();
     }
 }
 
+void MIDIMultiTrack::SetTrackLoader ( MIDITrackLoader *loader, int max_loaded_tracks_ )
+{
+    unsigned long old_version = GetVersion();
+
+    jdks_safe_delete_array( track_use );
+    jdks_safe_delete_array( track_loaded_version );
+
+    track_loader = loader;
+    max_loaded_tracks = max_loaded_tracks_;
+    num_loaded_tracks = 0;
+    use_count = 0;
+
+    if ( track_loader )
+    {
+        track_use = new unsigned long [number_of_tracks];
+        track_loaded_version = new unsigned long [number_of_tracks];
+
+        for ( int i = 0; i < number_of_tracks; ++i )
+        {
+            track_use[i] = 0;
+            track_loaded_version[i] = 0;
+        }
+    }
+
+    TracksReplaced ( old_version );
+}
+
+void MIDIMultiTrack::UnloadTrack ( int track_num )
+{
+    if ( track_loader && track_use[track_num] != 0 )
+    {
+        MIDITrack *t = tracks[track_num];
+        unsigned long v = t->GetVersion();
+
+        // unloading is no change of the contents, but the edits since loading are lost
+        bool edited = ( v != track_loaded_version[track_num] );
+        t->Clear();
+        t->Shrink();
+        load_changes += t->GetVersion() - v - ( edited ? 1 : 0 );
+        track_use[track_num] = 0;
+        --num_loaded_tracks;
+    }
+}
+
+void MIDIMultiTrack::UseTrack ( int track_num ) const
+{
+    if ( track_use[track_num] == 0 )
+    {
+        // loading and unloading change the tracks, not the multitrack
+        MIDIMultiTrack *mt = const_cast<MIDIMultiTrack *> ( this );
+
+        if ( max_loaded_tracks > 0 && num_loaded_tracks >= max_loaded_tracks )
+        {
+            int oldest = -1;
+
+            for ( int i = 0; i < number_of_tracks; ++i )
+            {
+                // tracks edited since loading are never unloaded, that would lose the edits
+                if ( track_use[i] != 0 && ( oldest < 0 || track_use[i] < track_use[oldest] ) &&
+                     tracks[i]->GetVersion() == track_loaded_version[i] )
+                    oldest = i;
+            }
+
+            if ( oldest >= 0 )
+                mt->UnloadTrack ( oldest );
+        }
+
+        // mark the track loaded first, the loader fills it through GetTrack()
+        track_use[track_num] = ++use_count;
+        ++num_loaded_tracks;
+
+        // loading is no change of the contents either
+        unsigned long v = tracks[track_num]->GetVersion();
+        track_loader->LoadTrack ( mt, track_num );
+        track_loaded_version[track_num] = tracks[track_num]->GetVersion();
+        load_changes += track_loaded_version[track_num] - v;
+    }
+
+    track_use[track_num] = ++use_count;
+}
+
 int MIDIMultiTrack::GetNumTracksWithEvents() const 
 {
     int i;
 
     for ( i = number_of_tracks - 1; i >= 0; --i )
     {
-        if ( !tracks[i]->IsTrackEmpty() )
+        if ( !GetTrack ( i )->IsTrackEmpty() )
             break;
     }
 
     return i+1;
 }
 
-void MIDIMultiTrack::SortEventsOrder()
+unsigned long MIDIMultiTrack::GetVersion() const
 {
-    for ( int i = 0; i < number_of_tracks; ++i )
+    if ( track_changes.unverified )
     {
-        if ( !tracks[i]->EventsOrderOK() )
+        // the tracks count their changes through non const accessors now,
+        // not GetTrack(), the version must not load tracks
+        track_changes.unverified = false;
+
+        for ( int i = 0; i < number_of_tracks; ++i )
+        {
+            if ( tracks[i] )
+                tracks[i]->GetVersion();
+        }
+    }
+
+    return version + track_changes.count - load_changes;
+}
+
+const MIDIMultiTrackStatistics &MIDIMultiTrack::GetStatistics() const
+{
+    if ( statistics_valid && statistics_version == GetVersion() )
+        return statistics;
+
+    MIDIMultiTrackStatistics s;
+
+    for ( int trk = 0; trk < number_of_tracks; ++trk )
+    {
+        const MIDITrack *t = GetTrack ( trk );
+
+        if ( !t )
+            continue;
+
+        s.num_events += t->GetNumEvents();
+
+        for ( int i = 0; i < t->GetNumEvents(); ++i )
         {
-            tracks[i]->SortEventsOrder();
+            const MIDITimedBigMessage *ev = t->GetEventAddress ( i );
+
+            if ( ev->ImplicitIsNoteOn() )
+                ++s.num_notes;
+
+            if ( !ev->IsEndOfTrack() && ev->GetTime() > s.duration_ticks )
+                s.duration_ticks = ev->GetTime();
         }
     }
+
+    MIDITempoMap tempo_map;
+    tempo_map.Build ( this );
+    s.duration_ms = tempo_map.TicksToMs ( s.duration_ticks );
+
+    statistics = s;
+    // after GetTrack(), which may have loaded tracks
+    statistics_version = GetVersion();
+    statistics_valid = true;
+    return statistics;
+}
+
+void MIDIMultiTrack::SortEventsOrder()
+{
+    // MIDITrack::SortEventsOrder() returns at once if the events are in order
+    for ( int i = 0; i < number_of_tracks; ++i )
+    {
+        GetTrack ( i )->SortEventsOrder();
+    }
 }
 
 
+static int TournamentLeaves ( int num_tracks )
+{
+    int n = 1;
+
+    while ( n < num_tracks )
+        n *= 2;
+
+    return n;
+}
+
 MIDIMultiTrackIteratorState::MIDIMultiTrackIteratorState ( int num_tracks_ )
 {
     num_tracks = num_tracks_;
     cur_event_track = 0;
     next_event_number = new int [num_tracks];
     next_event_time = new MIDIClockTime [num_tracks];
+    num_leaves = TournamentLeaves ( num_tracks );
+    min_time = new MIDIClockTime [2 * num_leaves];
     Reset();
 }
 
@@ -181,6 +458,8 @@ MIDIMultiTrackIteratorState::MIDIMultiTrackIteratorState ( const MIDIMultiTrackI
     cur_event_track = m.cur_event_track;
     next_event_number = new int [num_tracks];
     next_event_time = new MIDIClockTime [num_tracks];
+    num_leaves = m.num_leaves;
+    min_time = new MIDIClockTime [2 * num_leaves];
     cur_time = m.cur_time;
 
     for ( int i = 0; i < num_tracks; ++i )
@@ -188,12 +467,15 @@ MIDIMultiTrackIteratorState::MIDIMultiTrackIteratorState ( const MIDIMultiTrackI
         next_event_number[i] = m.next_event_number[i];
         next_event_time[i] = m.next_event_time[i];
     }
+
+    memcpy ( min_time, m.min_time, 2 * num_leaves * sizeof ( MIDIClockTime ) );
 }
 
 MIDIMultiTrackIteratorState::~MIDIMultiTrackIteratorState()
 {
     jdks_safe_delete_array( next_event_number );
     jdks_safe_delete_array( next_event_time );
+    jdks_safe_delete_array( min_time );
 }
 
 const MIDIMultiTrackIteratorState & MIDIMultiTrackIteratorState::operator = ( const MIDIMultiTrackIteratorState &m )
@@ -202,9 +484,12 @@ const MIDIMultiTrackIteratorState & MIDIMultiTrackIteratorState::operator = ( co
     {
         delete [] next_event_number;
         delete [] next_event_time;
+        delete [] min_time;
         num_tracks = m.num_tracks;
         next_event_number = new int [num_tracks];
         next_event_time = new MIDIClockTime [num_tracks];
+        num_leaves = m.num_leaves;
+        min_time = new MIDIClockTime [2 * num_leaves];
     }
 
     cur_time = m.cur_time;
@@ -216,6 +501,7 @@ const MIDIMultiTrackIteratorState & MIDIMultiTrackIteratorState::operator = ( co
         next_event_time[i] = m.next_event_time[i];
     }
 
+    memcpy ( min_time, m.min_time, 2 * num_leaves * sizeof ( MIDIClockTime ) );
     return *this;
 }
 
@@ -229,26 +515,94 @@ void MIDIMultiTrackIteratorState::Reset()
         next_event_number[i] = 0;
         next_event_time[i] = 0xffffffff;
     }
+
+    for ( int n = 0; n < 2 * num_leaves; ++n )
+    {
+        min_time[n] = 0xffffffff;
+    }
 }
 
-int MIDIMultiTrackIteratorState::FindTrackOfFirstEvent()
+void MIDIMultiTrackIteratorState::UpdateTrack ( int track_num )
 {
-    MIDIClockTime minimum_time = 0xffffffff;
-    int minimum_time_track = -1;
-    // go through all tracks and find the track with the smallest
-    // event time.
+    // tracks that have a current event number less than 0 are finished already
+    int n = num_leaves + track_num;
+    min_time[n] = ( next_event_number[track_num] >= 0 ) ? next_event_time[track_num] : 0xffffffff;
+
+    // replay the matches up to the root
+    for ( n /= 2; n > 0; n /= 2 )
+    {
+        MIDIClockTime t = std::min ( min_time[2*n], min_time[2*n+1] );
+
+        if ( min_time[n] == t )
+            break;
+
+        min_time[n] = t;
+    }
+}
+
+void MIDIMultiTrackIteratorState::UpdateAllTracks()
+{
+    int n;
 
-    for ( int j = 0; j < num_tracks; ++j )
+    for ( n = 0; n < num_tracks; ++n )
     {
-        int i = ( j + cur_event_track + 1 ) % num_tracks;
-        // skip any tracks that have a current event number less than 0 - these are
-        // finished already
+        min_time[num_leaves + n] = ( next_event_number[n] >= 0 ) ? next_event_time[n] : 0xffffffff;
+    }
+
+    for ( n = num_leaves - 1; n > 0; --n )
+    {
+        min_time[n] = std::min ( min_time[2*n], min_time[2*n+1] );
+    }
+}
+
+int MIDIMultiTrackIteratorState::FindFirstTrackAtOrBefore ( int track_num, MIDIClockTime time ) const
+{
+    if ( track_num >= num_tracks )
+        return -1;
+
+    // go up and right until a subtree holds such a track
+    int n = num_leaves + track_num;
 
-        if ( next_event_number[i] >= 0 && next_event_time[i] < minimum_time )
+    while ( min_time[n] > time )
+    {
+        while ( n & 1 )
         {
-            minimum_time = next_event_time[i];
-            minimum_time_track = i;
+            if ( n == 1 )
+                return -1;
+
+            n /= 2;
         }
+
+        ++n;
+    }
+
+    // then down to its leftmost such leaf
+    while ( n < num_leaves )
+    {
+        n *= 2;
+
+        if ( min_time[n] > time )
+            ++n;
+    }
+
+    return n - num_leaves;
+}
+
+int MIDIMultiTrackIteratorState::FindTrackOfFirstEvent()
+{
+    // the root of the tree holds the smallest event time, tracks with a
+    // time of 0xffffffff are never chosen
+    MIDIClockTime minimum_time = min_time[1];
+    int minimum_time_track = -1;
+
+    if ( minimum_time != 0xffffffff )
+    {
+        // of the tracks with the smallest time take the first one after the current
+        // track, else the first one from track 0
+        minimum_time_track = FindFirstTrackAtOrBefore ( cur_event_track + 1, minimum_time );
+
+        if ( minimum_time_track == -1 )
+            minimum_time_track = FindFirstTrackAtOrBefore ( 0, minimum_time );
     }
 
     // set cur_event_track to -1 if there are no more events left
@@ -304,6 +658,8 @@ void MIDIMultiTrackIterator::GoToTime ( MIDIClockTime time )
         }
     }
 
+    state.UpdateAllTracks();
+
     // are there any events at all? find the track with the
     // earliest event
 
@@ -428,6 +784,7 @@ bool MIDIMultiTrackIterator::GoToNextEventOnTrack ( int track_num )
     {
         // yes, set *event_num to -1
         *event_num = -1;
+        state.UpdateTrack ( track_num );
         return false; // at end of track
     }
 
@@ -437,6 +794,7 @@ bool MIDIMultiTrackIterator::GoToNextEventOnTrack ( int track_num )
         const MIDITimedBigMessage *msg;
         msg = track->GetEventAddress ( *event_num );
         state.next_event_time[ track_num ] = msg->GetTime();
+        state.UpdateTrack ( track_num );
     }
 
     return true;
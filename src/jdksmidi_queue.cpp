@@ -32,37 +32,107 @@
 namespace jdksmidi
 {
 
-MIDIQueue::MIDIQueue ( int num_msgs )
+MIDIQueue::MIDIQueue ( int num_msgs, int max_payload_ )
     :
     buf ( new MIDITimedBigMessage[ num_msgs ] ),
+    payload ( 0 ),
     bufsize ( num_msgs ),
+    max_payload ( max_payload_ > 0 ? max_payload_ : 0 ),
     next_in ( 0 ),
-    next_out ( 0 )
+    cached_out ( 0 ),
+    next_out ( 0 ),
+    cached_in ( 0 )
 {
+    if ( max_payload > 0 )
+        payload = new unsigned char[ ( size_t ) num_msgs * max_payload ];
+
+    slot_sysex.reserve ( num_msgs );
+
+    for ( int i = 0; i < num_msgs; ++i )
+        slot_sysex.emplace_back ( payload + ( size_t ) i * max_payload, max_payload, 0, false );
 }
 
 
 MIDIQueue::~MIDIQueue()
 {
     jdks_safe_delete_array( buf );
+    jdks_safe_delete_array( payload );
 }
 
 void MIDIQueue::Clear()
 {
-    next_in = 0;
-    next_out = 0;
+    next_in.store ( 0 );
+    next_out.store ( 0 );
+    cached_out = 0;
+    cached_in = 0;
 }
 
 bool MIDIQueue::CanPut() const
 {
-    return next_out != ( ( next_in + 1 ) % bufsize );
+    int in = next_in.load ( std::memory_order_relaxed ) + 1;
+
+    if ( in == bufsize )
+        in = 0;
+
+    // only look at the index of the consumer when the queue seems full
+    if ( in == cached_out )
+        cached_out = next_out.load ( std::memory_order_acquire );
+
+    return in != cached_out;
 }
 
 bool MIDIQueue::CanGet() const
 {
-    return next_in != next_out;
+    int out = next_out.load ( std::memory_order_relaxed );
+
+    // only look at the index of the producer when the queue seems empty
+    if ( out == cached_in )
+        cached_in = next_in.load ( std::memory_order_acquire );
+
+    return out != cached_in;
 }
 
+int MIDIQueue::GetFreeSpace() const
+{
+    int in = next_in.load ( std::memory_order_relaxed );
+    cached_out = next_out.load ( std::memory_order_acquire );
+    return ( cached_out - in - 1 + bufsize ) % bufsize;
+}
 
+bool MIDIQueue::Put ( const MIDITimedBigMessage &msg )
+{
+    const MIDISystemExclusive *sysex = msg.GetSysEx();
+    int len = sysex ? sysex->GetLengthSE() : 0;
+
+    if ( !CanPut() )
+        return false;
+
+    int in = next_in.load ( std::memory_order_relaxed );
+    MIDITimedBigMessage *slot = &buf[in];
+
+    // copy the message without its payload, this drops the payload of the previous one
+    MIDITimedMessage m ( msg );
+    m.SetTime ( msg.GetTime() );
+    slot->Copy ( m );
+
+    if ( len > max_payload )
+    {
+        // too long for the payload storage, the slot gets a copy on the heap
+        slot->CopySysEx ( sysex );
+    }
+
+    else if ( sysex )
+    {
+        // the slot's own sysex refers to its part of the payload storage
+        unsigned char *data = payload + ( size_t ) in * max_payload;
+        memcpy ( data, sysex->GetBuf(), len );
+        slot_sysex[in] = MIDISystemExclusive ( data, max_payload, len, false );
+        slot->AttachSysEx ( &slot_sysex[in] );
+    }
+
+    // publish the slot
+    next_in.store ( ( in + 1 == bufsize ) ? 0 : in + 1, std::memory_order_release );
+    return true;
+}
 
 }
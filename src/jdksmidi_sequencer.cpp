@@ -349,6 +349,11 @@ void MIDISequencerTrackState::Reset()
 
 
 bool MIDISequencerTrackState::Process ( MIDITimedBigMessage *msg )
+{
+    return ProcessEvent ( msg );
+}
+
+bool MIDISequencerTrackState::ProcessEvent ( const MIDITimedBigMessage *msg )
 {
     // is the event a NoOp?
     if ( msg->IsNoOp() )
@@ -486,9 +491,13 @@ MIDISequencerState::MIDISequencerState (
     cur_measure ( 0 ),
     next_beat_time ( 0 )
 {
-    for ( int i = 0; i < num_tracks; ++i )
+    // the state of track 0 holds the tempo and time signature, even without tracks
+    int num_states = std::max ( num_tracks, 1 );
+    track_state.reserve ( num_states );
+
+    for ( int i = 0; i < num_states; ++i )
     {
-        track_state[i] = new MIDISequencerTrackState ( s, i, notifier );
+        track_state.push_back ( MIDISequencerTrackState ( s, i, notifier ) );
     }
 }
 
@@ -497,6 +506,7 @@ MIDISequencerState::MIDISequencerState ( const MIDISequencerState &s )
     notifier ( s.notifier ),
     multitrack ( s.multitrack ),
     num_tracks ( s.num_tracks ),
+    track_state ( s.track_state ),
     iterator ( s.iterator ),
     cur_clock ( s.cur_clock ),
     cur_time_ms ( s.cur_time_ms ),
@@ -504,40 +514,18 @@ MIDISequencerState::MIDISequencerState ( const MIDISequencerState &s )
     cur_measure ( s.cur_measure ),
     next_beat_time ( s.next_beat_time )
 {
-    for ( int i = 0; i < num_tracks; ++i )
-    {
-        track_state[i] = new MIDISequencerTrackState ( *s.track_state[i] );
-    }
 }
 
 
 MIDISequencerState::~MIDISequencerState()
 {
-    for ( int i = 0; i < num_tracks; ++i )
-    {
-        jdks_safe_delete_object( track_state[i] );
-    }
 }
 
 const MIDISequencerState & MIDISequencerState::operator = ( const MIDISequencerState & s )
 {
-    if ( num_tracks != s.num_tracks )
-    {
-        {
-            for ( int i = 0; i < num_tracks; ++i )
-            {
-                jdks_safe_delete_object( track_state[i] );
-            }
-        }
-        num_tracks = s.num_tracks;
-        {
-            for ( int i = 0; i < num_tracks; ++i )
-            {
-                track_state[i] = new MIDISequencerTrackState ( *s.track_state[i] );
-            }
-        }
-    }
-
+    // copies the states in place when the number of tracks is unchanged
+    num_tracks = s.num_tracks;
+    track_state = s.track_state;
     iterator = s.iterator;
     cur_clock = s.cur_clock;
     cur_time_ms = s.cur_time_ms;
@@ -559,35 +547,37 @@ MIDISequencer::MIDISequencer (
     solo_mode ( false ),
     tempo_scale ( 100 ),
     num_tracks ( m->GetNumTracks() ),
+    track_processors ( num_tracks ),
+    checkpoint_events ( 0 ),
+    checkpoint_ms ( 0. ),
+    replaying ( false ),
+    replay_events ( 0 ),
     state ( this, m, n ) // TO DO: fix this hack
 {
-    for ( int i = 0; i < num_tracks; ++i )
-    {
-        track_processors[i] = new MIDISequencerTrackProcessor;
-    }
+    tempo_map.Build ( m );
+    multitrack_version = m->GetVersion();
 }
 
 
 MIDISequencer::~MIDISequencer()
 {
-    for ( int i = 0; i < num_tracks; ++i )
-    {
-        jdks_safe_delete_object( track_processors[i] );
-    }
 }
 
 void MIDISequencer::ResetTrack ( int trk )
 {
-    state.track_state[trk]->Reset();
-    track_processors[trk]->Reset();
+    state.track_state[trk].Reset();
+    track_processors[trk].Reset();
+    ClearCheckpoints();
 }
 
 void MIDISequencer::ResetAllTracks()
 {
+    ClearCheckpoints();
+
     for ( int i = 0; i < num_tracks; ++i )
     {
-        state.track_state[i]->Reset();
-        track_processors[i]->Reset();
+        state.track_state[i].Reset();
+        track_processors[i].Reset();
     }
 }
 
@@ -604,6 +594,7 @@ const MIDISequencerState *MIDISequencer::GetState() const
 void MIDISequencer::SetState ( MIDISequencerState *s )
 {
     state = *s;
+    replaying = false;
 }
 
 MIDIClockTime MIDISequencer::GetCurrentMIDIClockTime() const
@@ -634,27 +625,27 @@ double MIDISequencer::GetCurrentTempoScale() const
 
 double MIDISequencer::GetCurrentTempo() const
 {
-    return state.track_state[0]->tempobpm;
+    return state.track_state[0].tempobpm;
 }
 
 MIDISequencerTrackState * MIDISequencer::GetTrackState ( int trk )
 {
-    return state.track_state[trk];
+    return &state.track_state[trk];
 }
 
 const MIDISequencerTrackState * MIDISequencer::GetTrackState ( int trk ) const
 {
-    return state.track_state[ trk ];
+    return &state.track_state[ trk ];
 }
 
 MIDISequencerTrackProcessor * MIDISequencer::GetTrackProcessor ( int trk )
 {
-    return track_processors[trk];
+    return &track_processors[trk];
 }
 
 const MIDISequencerTrackProcessor * MIDISequencer::GetTrackProcessor ( int trk ) const
 {
-    return track_processors[ trk ];
+    return &track_processors[ trk ];
 }
 
 bool MIDISequencer::GetSoloMode() const
@@ -671,36 +662,165 @@ void MIDISequencer::SetSoloMode ( bool m, int trk )
 {
     int i;
     solo_mode = m;
+    ClearCheckpoints();
 
     for ( i = 0; i < num_tracks; ++i )
     {
         if ( i == trk )
         {
-            track_processors[i]->solo = true;
+            track_processors[i].solo = true;
         }
 
         else
         {
-            track_processors[i]->solo = false;
+            track_processors[i].solo = false;
         }
     }
 }
 
-void MIDISequencer::GoToZero()
+void MIDISequencer::ResetToZero()
 {
-    // go to time zero
-    for ( int i = 0; i < num_tracks; ++i )
+    for ( int i = 0; i < state.num_tracks; ++i )
     {
-        state.track_state[i]->GoToZero();
+        state.track_state[i].GoToZero();
     }
 
     state.iterator.GoToTime ( 0 );
     state.cur_time_ms = 0.0;
     state.cur_clock = 0;
-// state.next_beat_time = state.multitrack->GetClksPerBeat();
+//  state.next_beat_time = state.multitrack->GetClksPerBeat();
     state.next_beat_time =
         state.multitrack->GetClksPerBeat()
-        * 4 / ( state.track_state[0]->timesig_denominator );
+        * 4 / ( state.track_state[0].timesig_denominator );
+    state.cur_beat = 0;
+    state.cur_measure = 0;
+
+    // the multitrack may have changed since the last time
+    SyncToMultiTrack();
+
+    replaying = true;
+    replay_events = 0;
+}
+
+void MIDISequencer::SyncToMultiTrack()
+{
+    unsigned long v = state.multitrack->GetVersion();
+
+    if ( v != multitrack_version )
+    {
+        tempo_map.Build ( state.multitrack );
+        ClearCheckpoints();
+        multitrack_version = v;
+    }
+
+    // the track states of the checkpoints depend on the track processors
+    if ( !checkpoints.empty() )
+    {
+        for ( int i = 0; i < num_tracks; ++i )
+        {
+            if ( !track_processors[i].SameSettings ( checkpoint_processors[i] ) )
+            {
+                ClearCheckpoints();
+                break;
+            }
+        }
+    }
+}
+
+void MIDISequencer::SetCheckpointInterval ( int num_events, double time_ms )
+{
+    checkpoint_events = num_events;
+    checkpoint_ms = time_ms;
+    ClearCheckpoints();
+}
+
+void MIDISequencer::ClearCheckpoints()
+{
+    checkpoints.clear();
+    replaying = false;
+}
+
+void MIDISequencer::RestoreCheckpoint ( int n )
+{
+    state = checkpoints[n].state;
+
+    // the checkpoint may have been taken with another tempo scale
+    if ( tempo_scale > 0 )
+        state.cur_time_ms = ScaledMs ( state.cur_clock );
+
+    replaying = true;
+    replay_events = checkpoints[n].num_events;
+}
+
+int MIDISequencer::FindCheckpoint ( MIDIClockTime time_clk ) const
+{
+    // checkpoints are in replay order, so their times never decrease
+    int lo = 0, hi = ( int ) checkpoints.size();
+
+    while ( lo < hi )
+    {
+        int mid = ( lo + hi ) / 2;
+
+        if ( checkpoints[mid].state.cur_clock < time_clk )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo - 1;
+}
+
+int MIDISequencer::FindCheckpoint ( int measure, int beat ) const
+{
+    int lo = 0, hi = ( int ) checkpoints.size();
+
+    while ( lo < hi )
+    {
+        int mid = ( lo + hi ) / 2;
+        const MIDISequencerState &cs = checkpoints[mid].state;
+
+        if ( cs.cur_measure < measure || ( cs.cur_measure == measure && cs.cur_beat < beat ) )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo - 1;
+}
+
+bool MIDISequencer::ReplayNextEvent ( int *tracknum, const MIDITimedBigMessage **msg )
+{
+    if ( replaying && ( checkpoint_events > 0 || checkpoint_ms > 0. ) )
+    {
+        // only past the last checkpoint, so they stay in replay order
+        unsigned long last_events = 0;
+        MIDIClockTime last_clock = 0;
+
+        if ( !checkpoints.empty() )
+        {
+            last_events = checkpoints.back().num_events;
+            last_clock = checkpoints.back().state.cur_clock;
+        }
+
+        if ( replay_events > last_events &&
+                ( ( checkpoint_events > 0 && replay_events >= last_events + checkpoint_events )
+                  || ( checkpoint_ms > 0. &&
+                       tempo_map.TicksToMs ( state.cur_clock ) >= tempo_map.TicksToMs ( last_clock ) + checkpoint_ms ) ) )
+        {
+            if ( checkpoints.empty() )
+                checkpoint_processors = track_processors;
+
+            checkpoints.push_back ( MIDISequencerCheckpoint ( state, replay_events ) );
+        }
+    }
+
+    return GetNextEventRef ( tracknum, msg );
+}
+
+void MIDISequencer::GoToZero()
+{
+    // go to time zero
+    ResetToZero();
     // examine all the events at this specific time
     // and update the track states to reflect this time
     ScanEventsAtThisTime();
@@ -717,33 +837,32 @@ bool MIDISequencer::GoToTime ( MIDIClockTime time_clk )
         state.notifier->SetEnable ( false );
     }
 
+    SyncToMultiTrack();
+    int cp = FindCheckpoint ( time_clk );
+
     if ( time_clk < state.cur_clock || time_clk == 0 )
     {
-        // start from zero if desired time is before where we are
-        for ( int i = 0; i < state.num_tracks; ++i )
-        {
-            state.track_state[i]->GoToZero();
-        }
+        // start from the last checkpoint, or from zero, if desired time is before where we are
+        if ( cp >= 0 )
+            RestoreCheckpoint ( cp );
+        else
+            ResetToZero();
+    }
 
-        state.iterator.GoToTime ( 0 );
-        state.cur_time_ms = 0.0;
-        state.cur_clock = 0;
-//  state.next_beat_time = state.multitrack->GetClksPerBeat();
-        state.next_beat_time =
-            state.multitrack->GetClksPerBeat()
-            * 4 / ( state.track_state[0]->timesig_denominator );
-        state.cur_beat = 0;
-        state.cur_measure = 0;
+    else if ( cp >= 0 && checkpoints[cp].state.cur_clock > state.cur_clock )
+    {
+        // skip ahead to the checkpoint
+        RestoreCheckpoint ( cp );
     }
 
     MIDIClockTime t = 0;
     int trk;
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
 
     while (
         GetNextEventTime ( &t )
         && t < time_clk
-        && GetNextEvent ( &trk, &ev )
+        && ReplayNextEvent ( &trk, &ev )
     )
     {
         ;
@@ -775,33 +894,45 @@ bool MIDISequencer::GoToTimeMs ( float time_ms )
         state.notifier->SetEnable ( false );
     }
 
+    SyncToMultiTrack();
+    int cp = -1;
+
+    if ( tempo_scale > 0 )
+        cp = FindCheckpoint ( tempo_map.MsToTicks ( time_ms / ( 100. / tempo_scale ) ) );
+
     if ( time_ms < state.cur_time_ms || time_ms == 0.0 )
     {
-        // start from zero if desired time is before where we are
-        for ( int i = 0; i < state.num_tracks; ++i )
-        {
-            state.track_state[i]->GoToZero();
-        }
+        // start from the last checkpoint, or from zero, if desired time is before where we are
+        if ( cp >= 0 )
+            RestoreCheckpoint ( cp );
+        else
+            ResetToZero();
+    }
 
-        state.iterator.GoToTime ( 0 );
-        state.cur_time_ms = 0.0;
-        state.cur_clock = 0;
-//  state.next_beat_time = state.multitrack->GetClksPerBeat();
-        state.next_beat_time =
-            state.multitrack->GetClksPerBeat()
-            * 4 / ( state.track_state[0]->timesig_denominator );
-        state.cur_beat = 0;
-        state.cur_measure = 0;
+    else if ( cp >= 0 && checkpoints[cp].state.cur_clock > state.cur_clock )
+    {
+        // skip ahead to the checkpoint
+        RestoreCheckpoint ( cp );
     }
 
-    float t = 0;
+    // the first clock at or after time_ms, through the tempo map from the current position
+    MIDIClockTime time_clk = state.cur_clock;
+
+    if ( tempo_scale > 0 )
+    {
+        double offset_ms = state.cur_time_ms - ScaledMs ( state.cur_clock );
+        double map_ms = ( time_ms - offset_ms ) / ( 100. / tempo_scale );
+        time_clk = tempo_map.MsToTicks ( map_ms );
+    }
+
+    MIDIClockTime t = 0;
     int trk;
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
 
     while (
-        GetNextEventTimeMs ( &t )
-        && t < time_ms
-        && GetNextEvent ( &trk, &ev )
+        GetNextEventTime ( &t )
+        && t < time_clk
+        && ReplayNextEvent ( &trk, &ev )
     )
     {
         ;
@@ -833,33 +964,35 @@ bool MIDISequencer::GoToMeasure ( int measure, int beat )
         state.notifier->SetEnable ( false );
     }
 
+    SyncToMultiTrack();
+    int cp = FindCheckpoint ( measure, beat );
+
     if ( measure < state.cur_measure || measure == 0 )
     {
-        for ( int i = 0; i < state.num_tracks; ++i )
-        {
-            state.track_state[i]->GoToZero();
-        }
+        if ( cp >= 0 )
+            RestoreCheckpoint ( cp );
+        else
+            ResetToZero();
+    }
 
-        state.iterator.GoToTime ( 0 );
-        state.cur_time_ms = 0.0;
-        state.cur_clock = 0;
-        state.cur_beat = 0;
-        state.cur_measure = 0;
-//  state.next_beat_time = state.multitrack->GetClksPerBeat();
-        state.next_beat_time =
-            state.multitrack->GetClksPerBeat()
-            * 4 / ( state.track_state[0]->timesig_denominator );
+    else if ( cp >= 0 &&
+              ( checkpoints[cp].state.cur_measure > state.cur_measure ||
+                ( checkpoints[cp].state.cur_measure == state.cur_measure
+                  && checkpoints[cp].state.cur_beat > state.cur_beat ) ) )
+    {
+        // skip ahead to the checkpoint
+        RestoreCheckpoint ( cp );
     }
 
     MIDIClockTime t = 0;
     int trk;
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
     // iterate thru all the events until cur-measure and cur_beat are
     // where we want them.
 
     while (
         GetNextEventTime ( &t )
-        && GetNextEvent ( &trk, &ev )
+        && ReplayNextEvent ( &trk, &ev )
         && state.cur_measure <= measure
     )
     {
@@ -892,20 +1025,12 @@ bool MIDISequencer::GetNextEventTimeMs ( double *t )
 
     if ( f )
     {
-        // calculate delta time from last event time
-        double delta_clocks = ( double ) ( ct - state.cur_clock );
-        // calculate tempo in milliseconds per clock
-        double clocks_per_sec = ( ( state.track_state[0]->tempobpm *
-                                    ( ( ( double ) tempo_scale ) * 0.01 )
-                                    * ( 1. / 60. ) ) * state.multitrack->GetClksPerBeat() );
-
-        if ( clocks_per_sec > 0. )
+        if ( tempo_scale > 0 && tempo_map.GetDivision() > 0 )
         {
-            double ms_per_clock = 1000. / clocks_per_sec;
-            // calculate delta time in milliseconds
-            double delta_ms = delta_clocks * ms_per_clock;
-            // return it added with the current time in ms.
-            *t = delta_ms + state.cur_time_ms;
+            // time through the tempo map scaled by the tempo scale, plus the offset of the
+            // current time to it (0 unless the tempo scale changed), so times are exact
+            double offset_ms = state.cur_time_ms - ScaledMs ( state.cur_clock );
+            *t = ScaledMs ( ct ) + offset_ms;
         }
 
         else
@@ -945,6 +1070,84 @@ bool MIDISequencer::GetNextEventTime ( MIDIClockTime *t )
 }
 
 bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
+{
+    const MIDITimedBigMessage *ev = NextEvent ( tracknum, msg );
+
+    if ( !ev )
+        return false;
+
+    // copy the event unless it was processed in place
+    if ( ev != msg )
+        *msg = *ev;
+
+    return true;
+}
+
+bool MIDISequencer::GetNextEventRef ( int *tracknum, const MIDITimedBigMessage **msg )
+{
+    *msg = NextEvent ( tracknum, &event_copy );
+    return *msg != 0;
+}
+
+int MIDISequencer::GetEventsUntil ( double time_ms, std::vector< MIDISequencerEvent > *buffer, int max_events )
+{
+    if ( tempo_scale <= 0 || tempo_map.GetDivision() <= 0 )
+        return 0;
+
+    // an event at clock t is due when ScaledMs ( t ) + offset_ms <= time_ms, as with
+    // GetNextEventTimeMs()
+    double offset_ms = state.cur_time_ms - ScaledMs ( state.cur_clock );
+    MIDIClockTime t;
+
+    if ( !GetNextEventTime ( &t ) || ScaledMs ( t ) + offset_ms > time_ms )
+        return 0; // nothing is due yet
+
+    int num_events = 0;
+
+    // the latest clock known to be due; clocks are checked once, not once per event
+    MIDIClockTime due_clk = t;
+
+    while ( ( max_events <= 0 || num_events < max_events ) && GetNextEventTime ( &t ) )
+    {
+        if ( t > due_clk )
+        {
+            if ( ScaledMs ( t ) + offset_ms > time_ms )
+                break;
+
+            due_clk = t;
+        }
+
+        if ( num_events == ( int ) buffer->size() )
+            buffer->resize ( num_events + 1 );
+
+        // a processed event is made directly in its buffer entry
+        MIDISequencerEvent &entry = ( *buffer ) [num_events];
+        const MIDITimedBigMessage *ev = NextEvent ( &entry.track, &entry.copy, false );
+
+        if ( !ev )
+            break;
+
+        if ( ev == &beat_marker_msg )
+        {
+            entry.copy = *ev;
+            entry.in_track = 0;
+        }
+
+        else
+        {
+            entry.in_track = ( ev == &entry.copy ) ? 0 : ev;
+        }
+
+        ++num_events;
+    }
+
+    if ( num_events > 0 )
+        state.cur_time_ms = ScaledMs ( state.cur_clock ) + offset_ms;
+
+    return num_events;
+}
+
+const MIDITimedBigMessage *MIDISequencer::NextEvent ( int *tracknum, MIDITimedBigMessage *copy, bool update_time_ms )
 {
     MIDIClockTime t;
 
@@ -953,13 +1156,18 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
     {
         // move current time forward one event
         MIDIClockTime new_clock;
-        float new_time_ms = 0.0f;
         GetNextEventTime ( &new_clock );
-        GetNextEventTimeMs ( &new_time_ms );
+
+        if ( update_time_ms )
+        {
+            double new_time_ms = 0.0;
+            GetNextEventTimeMs ( &new_time_ms );
+            state.cur_time_ms = new_time_ms;
+        }
+
         // must set cur_clock AFTER GetnextEventTimeMs() is called
         // since GetNextEventTimeMs() uses cur_clock to calculate
         state.cur_clock = new_clock;
-        state.cur_time_ms = new_time_ms;
         // is the next beat marker before this event?
 
         if ( state.next_beat_time <= t )
@@ -970,13 +1178,12 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
             // put current info into beat marker message
             beat_marker_msg.SetBeatMarker();
             beat_marker_msg.SetTime ( state.next_beat_time );
-            *msg = beat_marker_msg;
             // update our beat count
             int new_beat = state.cur_beat + 1;
             int new_measure = state.cur_measure;
             // do we need to update the measure number?
 
-            if ( new_beat >= state.track_state[0]->timesig_numerator )
+            if ( new_beat >= state.track_state[0].timesig_numerator )
             {
                 // yup
                 new_beat = 0;
@@ -991,7 +1198,7 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
             // denom=0  (1)  ---> 4/1 midi file beats per symbolic beat
             state.next_beat_time +=
                 state.multitrack->GetClksPerBeat()
-                * 4 / ( state.track_state[0]->timesig_denominator );
+                * 4 / ( state.track_state[0].timesig_denominator );
             state.cur_beat = new_beat;
             state.cur_measure = new_measure;
 
@@ -1022,8 +1229,9 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
             }
 
             // give the beat marker event to the conductor track to process
-            state.track_state[*tracknum]->Process ( msg );
-            return true;
+            state.track_state[*tracknum].ProcessEvent ( &beat_marker_msg );
+            ++replay_events;
+            return &beat_marker_msg;
         }
 
         else // this event comes before the next beat
@@ -1033,8 +1241,7 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
             if ( state.iterator.GetCurEvent ( tracknum, &msg_ptr ) )
             {
                 int trk = *tracknum;
-                // copy the event so Process can modify it
-                *msg = *msg_ptr;
+                const MIDITimedBigMessage *msg = msg_ptr;
                 bool allow_msg = true;
                 // are we in solo mode?
 
@@ -1043,7 +1250,7 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
                     // yes, only allow this message thru if
                     // the track is either track 0
                     // or it is explicitly solod.
-                    if ( trk == 0 || track_processors[trk]->solo )
+                    if ( trk == 0 || track_processors[trk].solo )
                     {
                         allow_msg = true;
                     }
@@ -1054,24 +1261,45 @@ bool MIDISequencer::GetNextEvent ( int *tracknum, MIDITimedBigMessage *msg )
                     }
                 }
 
-                if ( ! ( allow_msg
-                         && track_processors[trk]->Process ( msg )
-                         && state.track_state[trk]->Process ( msg ) )
-                   )
+                if ( !allow_msg )
                 {
                     // the message is not allowed to come out!
                     // erase it
-                    msg->SetNoOp();
+                    copy->SetNoOp();
+                    copy->SetTime ( msg_ptr->GetTime() );
+                    msg = copy;
+                }
+
+                else if ( track_processors[trk].IsTransparent() )
+                {
+                    // the event comes out as it is in the track, no copy needed
+                    state.track_state[trk].ProcessEvent ( msg );
+                }
+
+                else
+                {
+                    // copy the event so Process can modify it
+                    *copy = *msg_ptr;
+                    msg = copy;
+
+                    if ( ! ( track_processors[trk].Process ( copy )
+                             && state.track_state[trk].Process ( copy ) ) )
+                    {
+                        // the message is not allowed to come out!
+                        // erase it
+                        copy->SetNoOp();
+                    }
                 }
 
                 // go to the next event on the multitrack
                 state.iterator.GoToNextEvent();
-                return true;
+                ++replay_events;
+                return msg;
             }
         }
     }
 
-    return false;
+    return 0;
 }
 
 void MIDISequencer::ScanEventsAtThisTime()
@@ -1085,12 +1313,12 @@ void MIDISequencer::ScanEventsAtThisTime()
     double orig_time_ms = state.cur_time_ms;
     MIDIClockTime t = 0;
     int trk;
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
 
     while (
         GetNextEventTime ( &t )
         && t == orig_clock
-        && GetNextEvent ( &trk, &ev )
+        && GetNextEventRef ( &trk, &ev )
     )
     {
         ;
@@ -1100,33 +1328,20 @@ void MIDISequencer::ScanEventsAtThisTime()
     state.iterator.SetState ( istate );
     // and current time
     state.cur_clock = orig_clock;
-    state.cur_time_ms = float ( orig_time_ms );
+    state.cur_time_ms = orig_time_ms;
     state.cur_measure = prev_measure;
     state.cur_beat = prev_beat;
+    // but the track states have seen the events at this time, unlike a replay from zero
+    replaying = false;
 }
 
 double MIDISequencer::GetMisicDurationInSeconds()
 {
-    double event_time = 0.; // in milliseconds
-
-    MIDITimedBigMessage ev;
-    int ev_track;
-
-    GoToZero();
-
-    while ( GetNextEvent( &ev_track, &ev ) )
-    {
-        // std::cout << EventAsText( ev ) << std::endl;
-
-        // skip these events
-        if ( ev.IsEndOfTrack() || ev.IsBeatMarker() )
-            continue;
-
-        // end of music is the time of last not end of track midi event!
-        event_time = GetCurrentTimeInMs();
-    }
+    if ( tempo_scale <= 0 )
+        return 0.;
 
-    return ( 0.001 * event_time );
+    // the duration is cached by the multitrack until it changes
+    return 0.001 * state.multitrack->GetDurationMs() * ( 100. / tempo_scale );
 }
 
 
@@ -53,31 +53,50 @@ namespace jdksmidi
 MIDISystemExclusive::MIDISystemExclusive ( int size_ )
 {
     ENTER ( "MIDISystemExclusive::MIDISystemExclusive" );
-    buf = new uchar[size_];
 
-    if ( buf )
+    if ( size_ <= INLINE_SIZE )
+    {
+        buf = inline_buf;
         max_len = size_;
-
+        deletable = false;
+    }
     else
-        max_len = 0;
+    {
+        buf = new uchar[size_];
+
+        if ( buf )
+            max_len = size_;
+
+        else
+            max_len = 0;
+
+        deletable = true;
+    }
 
     cur_len = 0;
     chk_sum = 0;
-    deletable = true;
 }
 
 MIDISystemExclusive::MIDISystemExclusive ( const MIDISystemExclusive &e )
 {
-    buf = new unsigned char [e.max_len];
-    max_len = e.max_len;
-    cur_len = e.cur_len;
-    chk_sum = e.chk_sum;
-    deletable = true;
+    int size = e.GetCapacity();
 
-    for ( int i = 0; i < cur_len; ++i )
+    if ( size <= INLINE_SIZE )
     {
-        buf[i] = e.buf[i];
+        buf = inline_buf;
+        max_len = INLINE_SIZE;
+        deletable = false;
     }
+    else
+    {
+        buf = new unsigned char [size];
+        max_len = size;
+        deletable = true;
+    }
+
+    cur_len = e.cur_len;
+    chk_sum = e.chk_sum;
+    memcpy ( buf, e.buf, cur_len );
 }
 
 MIDISystemExclusive::~MIDISystemExclusive()
@@ -90,6 +109,29 @@ MIDISystemExclusive::~MIDISystemExclusive()
     }
 }
 
+const MIDISystemExclusive &MIDISystemExclusive::operator = ( const MIDISystemExclusive &e )
+{
+    if ( this == &e )
+        return *this;
+
+    bool own_buf = ( buf == inline_buf || deletable );
+
+    if ( own_buf && max_len >= e.GetCapacity() )
+    {
+        // our buffer is big enough, simply overwrite it
+        cur_len = e.cur_len;
+        chk_sum = e.chk_sum;
+        memcpy ( buf, e.buf, cur_len );
+    }
+    else
+    {
+        MIDISystemExclusive tmp ( e );
+        Swap ( tmp );
+    }
+
+    return *this;
+}
+
 bool operator == ( const MIDISystemExclusive &e1, const MIDISystemExclusive &e2 )
 {
     if ( e1.cur_len != e2.cur_len )
@@ -35,3 +35,148 @@
 #include "jdksmidi/tempo.h"
 
 
+#include "jdksmidi/multitrack.h"
+
+namespace jdksmidi
+{
+
+static bool EarlierChange (
+    const std::pair< MIDIClockTime, unsigned long > &a,
+    const std::pair< MIDIClockTime, unsigned long > &b
+)
+{
+    return a.first < b.first;
+}
+
+MIDITempoMap::MIDITempoMap()
+{
+    Clear();
+}
+
+void MIDITempoMap::Clear()
+{
+    Segment s;
+    s.time = 0;
+    s.usec_per_beat = 500000; // 120 bpm until the first tempo event
+    s.usec_clocks = 0.;
+
+    division = 0;
+    segments.clear();
+    segments.push_back ( s );
+}
+
+void MIDITempoMap::Build ( const MIDIMultiTrack *mt )
+{
+    Clear();
+
+    if ( !mt || mt->GetNumTracks() == 0 )
+        return;
+
+    division = mt->GetClksPerBeat();
+
+    const MIDITrack *trk = mt->GetTrack ( 0 );
+    std::vector< std::pair< MIDIClockTime, unsigned long > > changes;
+
+    for ( int i = 0; i < trk->GetNumEvents(); ++i )
+    {
+        const MIDITimedBigMessage *msg = trk->GetEventAddress ( i );
+
+        if ( !msg->IsTempo() )
+            continue;
+
+        changes.push_back ( std::make_pair ( msg->GetTime(), LimitTempo ( msg->GetTempo() ) ) );
+    }
+
+    if ( !trk->EventsOrderOK() )
+    {
+        std::stable_sort ( changes.begin(), changes.end(), EarlierChange );
+    }
+
+    for ( size_t i = 0; i < changes.size(); ++i )
+    {
+        Segment &last = segments.back();
+
+        // the last of several tempos at the same time is in effect
+        if ( changes[i].first == last.time )
+        {
+            last.usec_per_beat = changes[i].second;
+            continue;
+        }
+
+        Segment s;
+        s.time = changes[i].first;
+        s.usec_per_beat = changes[i].second;
+        s.usec_clocks = last.usec_clocks + double ( s.time - last.time ) * last.usec_per_beat;
+        segments.push_back ( s );
+    }
+}
+
+const MIDITempoMap::Segment &MIDITempoMap::FindSegment ( MIDIClockTime t ) const
+{
+    // the last segment starting at or before t
+    size_t lo = 0, hi = segments.size();
+
+    while ( hi - lo > 1 )
+    {
+        size_t mid = ( lo + hi ) / 2;
+
+        if ( segments[mid].time <= t )
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return segments[lo];
+}
+
+double MIDITempoMap::TicksToMs ( MIDIClockTime t ) const
+{
+    if ( division <= 0 )
+        return 0.;
+
+    return ToMs ( FindSegment ( t ), t );
+}
+
+MIDIClockTime MIDITempoMap::MsToTicks ( double time_ms ) const
+{
+    if ( division <= 0 || time_ms <= 0. )
+        return 0;
+
+    // the last segment starting at or before time_ms
+    size_t lo = 0, hi = segments.size();
+
+    while ( hi - lo > 1 )
+    {
+        size_t mid = ( lo + hi ) / 2;
+
+        if ( ToMs ( segments[mid], segments[mid].time ) <= time_ms )
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    const Segment &s = segments[lo];
+    double clocks = ( time_ms * 1000. * division - s.usec_clocks ) / s.usec_per_beat;
+    double max_clocks = double ( ( MIDIClockTime ) -1 ) - s.time;
+
+    if ( clocks >= max_clocks )
+        return ( MIDIClockTime ) -1;
+
+    // the estimate may be one clock off by rounding, settle it on the times TicksToMs() returns
+    MIDIClockTime t = s.time + ( MIDIClockTime ) clocks;
+
+    while ( ToMs ( s, t ) < time_ms )
+        ++t;
+
+    while ( t > s.time && ToMs ( s, t - 1 ) >= time_ms )
+        --t;
+
+    return t;
+}
+
+unsigned long MIDITempoMap::GetTempoAt ( MIDIClockTime t ) const
+{
+    return FindSegment ( t ).usec_per_beat;
+}
+
+}
@@ -50,27 +50,106 @@
 namespace jdksmidi
 {
 
-const MIDITimedBigMessage * MIDITrackChunk::GetEventAddress ( int event_num ) const
+MIDIPayloadArena::MIDIPayloadArena()
 {
-    return &buf[event_num];
+    blocks = 0;
+    heap_size = 0;
 }
 
-MIDITimedBigMessage * MIDITrackChunk::GetEventAddress ( int event_num )
+MIDIPayloadArena::~MIDIPayloadArena()
 {
-    return &buf[event_num];
+    Clear();
 }
 
+void MIDIPayloadArena::Clear()
+{
+    while ( blocks )
+    {
+        Block *next = blocks->next;
+        ::operator delete ( blocks );
+        blocks = next;
+    }
+
+    heap_size = 0;
+}
 
+MIDIPayloadArena::Block *MIDIPayloadArena::NewBlock ( int size )
+{
+    // nothrow, so a failed allocation reaches the callers as 0
+    Block *b = static_cast<Block *> ( ::operator new ( sizeof ( Block ) + size, std::nothrow ) );
 
+    if ( b )
+    {
+        b->next = 0;
+        b->size = size;
+        b->used = 0;
+        heap_size += sizeof ( Block ) + size;
+    }
+
+    return b;
+}
+
+void *MIDIPayloadArena::Allocate ( int size )
+{
+    size = ( size + ALIGN - 1 ) & ~( ALIGN - 1 );
+
+    if ( blocks && blocks->used + size <= blocks->size )
+    {
+        void *p = reinterpret_cast<unsigned char *> ( blocks + 1 ) + blocks->used;
+        blocks->used += size;
+        return p;
+    }
+
+    // the blocks grow with the amount of payload data, up to MAX_BLOCK_SIZE
+    int block_size = blocks ? blocks->size * 2 : MIN_BLOCK_SIZE;
+
+    if ( block_size > MAX_BLOCK_SIZE )
+        block_size = MAX_BLOCK_SIZE;
+
+    if ( size > block_size / 2 )
+    {
+        // big payloads (e.g. sysex dumps) get a block of their own, behind the current block
+        Block *b = NewBlock ( size );
+
+        if ( !b )
+            return 0;
+
+        b->used = size;
+
+        if ( blocks )
+        {
+            b->next = blocks->next;
+            blocks->next = b;
+        }
+        else
+        {
+            blocks = b;
+        }
+
+        return b + 1;
+    }
 
+    Block *b = NewBlock ( block_size );
+
+    if ( !b )
+        return 0;
+
+    b->next = blocks;
+    b->used = size;
+    blocks = b;
+    return b + 1;
+}
 
 MIDITrack::MIDITrack ( int size )
 {
+    buf = 0;
     buf_size = 0;
     num_events = 0;
-
-    for ( int i = 0; i < MIDIChunksPerTrack; ++i )
-        chunk[i] = 0;
+    version = 0;
+    changes = 0;
+    ordered_events = 0;
+    unverified = false;
+    time_index_step = 0;
 
     if ( size )
     {
@@ -80,28 +159,67 @@ MIDITrack::MIDITrack ( int size )
 
 MIDITrack::MIDITrack ( const MIDITrack &t )
 {
+    buf = 0;
     buf_size = 0;
     num_events = 0;
+    version = 0;
+    changes = 0;
+    ordered_events = 0;
+    unverified = false;
+    time_index_step = t.time_index_step;
+
+    if ( t.GetNumEvents() )
+    {
+        Expand ( t.GetNumEvents() );
+    }
 
     for ( int i = 0; i < t.GetNumEvents(); ++i )
     {
-        const MIDITimedBigMessage *src;
-        src = t.GetEventAddress ( i );
-        PutEvent ( *src ); // it execute Expand()
+        PutEvent ( *t.GetEventAddress ( i ) );
     }
 }
 
+MIDITrack::MIDITrack ( MIDITrack &&t )
+{
+    buf = t.buf;
+    buf_size = t.buf_size;
+    num_events = t.num_events;
+    version = t.version;
+    changes = 0;
+    ordered_events = t.ordered_events;
+    unverified = t.unverified;
+    time_index_step = t.time_index_step;
+    payload.Swap ( t.payload );
+    time_index.swap ( t.time_index );
+
+    t.buf = 0;
+    t.buf_size = 0;
+    t.num_events = 0;
+    t.Changed();
+    t.ordered_events = 0;
+    t.unverified = false;
+}
+
 MIDITrack::~MIDITrack()
 {
-    for ( int i = 0; i < buf_size / MIDITrackChunkSize; ++i )
-    {
-        jdks_safe_delete_object( chunk[i] );
-    }
+    Clear();
+    ::operator delete ( buf );
 }
 
 void MIDITrack::Clear()
 {
+    // only the first num_events items of buf are constructed
+    for ( int i = 0; i < num_events; ++i )
+    {
+        buf[i].~MIDITimedBigMessage();
+    }
+
     num_events = 0;
+    Changed();
+    ordered_events = 0;
+    unverified = false;
+    time_index.clear();
+    payload.Clear();
 }
 
 bool MIDITrack::EventsOrderOK() const
@@ -109,9 +227,13 @@ bool MIDITrack::EventsOrderOK() const
     if ( num_events < 2 )
         return true;
 
-    MIDIClockTime time0 = GetEventAddress(0)->GetTime();
+    Verify();
 
-    for ( int i = 1; i < num_events; ++i )
+    // no need to test the events known to be in order
+    int first = ( ordered_events > 1 ) ? ordered_events : 1;
+    MIDIClockTime time0 = GetEventAddress( first - 1 )->GetTime();
+
+    for ( int i = first; i < num_events; ++i )
     {
         MIDIClockTime time1 = GetEventAddress(i)->GetTime();
         if ( time0 > time1 )
@@ -124,28 +246,139 @@ bool MIDITrack::EventsOrderOK() const
 
 void MIDITrack::SortEventsOrder()
 {
-    std::vector< Event_time > et( num_events );
+    // the events up to the first out of order one need no sorting,
+    // for tracks which are already in order this is all we do
+    Verify();
+    ExtendOrderedEvents();
+    int k = ordered_events;
+
+    if ( k >= num_events )
+        return;
 
+    Changed();
+
+    // stable sort of the remaining events by their time
     int n;
-    for ( n = 0; n < num_events; ++n )
+    int num_suffix = num_events - k;
+    std::vector< Event_time > et( num_suffix );
+
+    for ( n = 0; n < num_suffix; ++n )
     {
-        et[n].event_number = n;
-        et[n].time = GetEventAddress(n)->GetTime();
+        et[n].event_number = k + n;
+        et[n].time = buf[k + n].GetTime();
     }
 
     std::stable_sort( et.begin(), et.end(), Event_time::less );
 
-    MIDITrack trk( num_events );
+    // the first p events are not later than any of the remaining events, they keep their place
+    int p = 0;
+    int hi = k;
+
+    while ( p < hi )
+    {
+        int mid = ( p + hi ) / 2;
+
+        if ( buf[mid].GetTime() <= et[0].time )
+            p = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // merge events p...k-1 with the sorted remaining events, on equal times the earlier event goes first.
+    // order[i] is the event number of the event which goes to position p+i
+    std::vector< int > order( num_events - p );
+    int i1 = p, i2 = 0, o = 0;
 
-    for ( n = 0; n < num_events; ++n )
+    while ( i1 < k && i2 < num_suffix )
     {
-        int event_num = et[n].event_number;
-        const MIDITimedBigMessage *src;
-        src = GetEventAddress( event_num );
-        trk.PutEvent( *src ); // add src event to trk
+        if ( et[i2].time < buf[i1].GetTime() )
+            order[o++] = et[i2++].event_number;
+        else
+            order[o++] = i1++;
     }
 
-    *this = trk;
+    while ( i1 < k )
+        order[o++] = i1++;
+
+    while ( i2 < num_suffix )
+        order[o++] = et[i2++].event_number;
+
+    // move the events to their places in place, following the cycles of the permutation
+    for ( n = p; n < num_events; ++n )
+    {
+        if ( order[n-p] < 0 || order[n-p] == n )
+            continue;
+
+        MIDITimedBigMessage tmp( std::move( buf[n] ) );
+        int dst = n;
+
+        for ( ;; )
+        {
+            int src = order[dst-p];
+            order[dst-p] = -1;
+
+            if ( src == n )
+            {
+                buf[dst] = std::move( tmp );
+                break;
+            }
+
+            buf[dst] = std::move( buf[src] );
+            dst = src;
+        }
+    }
+
+    // events from p on have moved
+    ordered_events = p;
+    ExtendOrderedEvents();
+}
+
+void MIDITrack::VerifyEvents() const
+{
+    // any event may have been changed, count it as a change and find the ordered events anew
+    unverified = false;
+    Changed();
+    ordered_events = 0;
+    ExtendOrderedEvents();
+}
+
+void MIDITrack::ExtendOrderedEvents() const
+{
+    int n = ordered_events;
+
+    if ( n == 0 && num_events > 0 )
+        n = 1;
+
+    while ( n < num_events && buf[n-1].GetTime() <= buf[n].GetTime() )
+        ++n;
+
+    if ( time_index_step > 0 )
+    {
+        // drop the entries of events no more known to be in order, then add the new ones
+        int entries = ( ordered_events + time_index_step - 1 ) / time_index_step;
+        time_index.resize ( entries );
+
+        for ( int i = entries * time_index_step; i < n; i += time_index_step )
+            time_index.push_back ( buf[i].GetTime() );
+    }
+
+    ordered_events = n;
+}
+
+void MIDITrack::SetTimeIndexStep ( int step )
+{
+    Verify();
+    time_index_step = ( step > 0 ) ? step : 0;
+    time_index.clear();
+
+    // rebuild the index of the ordered events
+    int n = ordered_events;
+    ordered_events = 0;
+
+    if ( time_index_step > 0 )
+        ExtendOrderedEvents();
+    else
+        ordered_events = n;
 }
 
 int MIDITrack::RemoveIdenticalEvents( int max_distance_between_identical_events )
@@ -154,14 +387,14 @@ int MIDITrack::RemoveIdenticalEvents( int max_distance_between_identical_events
 
     for ( int n = 0; n < num_events; ++n )
     {
-        MIDITimedBigMessage *mn = GetEvent( n );
+        const MIDITimedBigMessage *mn = &buf[n];
 
         for (int i = 1; i < max_distance_between_identical_events; ++i)
         {
             if ( (n+i) >= num_events )
                 break;
 
-            MIDITimedBigMessage *mni = GetEvent( n+i );
+            const MIDITimedBigMessage *mni = &buf[n+i];
             if ( *mn == *mni )
             {
                 ++removed;
@@ -176,28 +409,50 @@ int MIDITrack::RemoveIdenticalEvents( int max_distance_between_identical_events
 
 const MIDITrack & MIDITrack::operator = ( const MIDITrack & src )
 {
-    if ( num_events == src.num_events )
+    if ( this == &src )
+        return *this;
+
+    Clear();
+    time_index_step = src.time_index_step;
+
+    if ( buf_size < src.num_events && !Reallocate ( src.num_events ) )
+        return *this;
+
+    for ( int n = 0; n < src.num_events; ++n )
     {
-        for ( int n = 0; n < num_events; ++n )
-        {
-            const MIDITimedBigMessage * msg = src.GetEventAddress( n );
-            SetEvent( n, *msg );
-        }
+        PutEvent ( *src.GetEventAddress( n ) );
     }
-    else
-    {
-        this->~MIDITrack();
 
-        buf_size = 0;
-        num_events = 0;
+    return *this;
+}
 
-        for ( int i = 0; i < src.GetNumEvents(); ++i )
-        {
-            const MIDITimedBigMessage *msg = src.GetEventAddress ( i );
-            PutEvent ( *msg ); // it execute Expand()
-        }
-    }
+const MIDITrack & MIDITrack::operator = ( MIDITrack && src )
+{
+    if ( this == &src )
+        return *this;
 
+    Clear();
+    ::operator delete ( buf );
+
+    buf = src.buf;
+    buf_size = src.buf_size;
+    num_events = src.num_events;
+    ordered_events = src.ordered_events;
+    unverified = src.unverified;
+    time_index_step = src.time_index_step;
+    payload.Swap ( src.payload );
+    time_index.swap ( src.time_index );
+
+    // the changes of src through non const accessors are ours now
+    if ( unverified && changes )
+        changes->unverified = true;
+
+    src.buf = 0;
+    src.buf_size = 0;
+    src.num_events = 0;
+    src.Changed();
+    src.ordered_events = 0;
+    src.unverified = false;
     return *this;
 }
 
@@ -221,10 +476,10 @@ void MIDITrack::ClearAndMerge (
     )
     {
         // skip any NOPs on track 1
-        ev1 = src1->GetEventAddress ( cur_trk1ev );
-        ev2 = src2->GetEventAddress ( cur_trk2ev );
-        bool has_ev1 = ( cur_trk1ev < num_trk1ev ) && ev1;
-        bool has_ev2 = ( cur_trk2ev < num_trk2ev ) && ev2;
+        ev1 = ( cur_trk1ev < num_trk1ev ) ? src1->GetEventAddress ( cur_trk1ev ) : 0;
+        ev2 = ( cur_trk2ev < num_trk2ev ) ? src2->GetEventAddress ( cur_trk2ev ) : 0;
+        bool has_ev1 = ( ev1 != 0 );
+        bool has_ev2 = ( ev2 != 0 );
 
         if ( has_ev1 && ev1->IsNoOp() )
         {
@@ -446,67 +701,88 @@ void MIDITrack::Sort()
 
 void MIDITrack::Shrink()
 {
-    int num_chunks_used = ( int ) ( ( num_events / MIDITrackChunkSize ) + 1 );
-    int num_chunks_alloced = ( int ) ( buf_size / MIDITrackChunkSize );
-
-    if ( num_chunks_used < num_chunks_alloced )
+    if ( num_events < buf_size )
     {
-        for ( int i = num_chunks_used; i < num_chunks_alloced; ++i )
-        {
-            jdks_safe_delete_object( chunk[i] );
-        }
-
-        buf_size = num_chunks_used * MIDITrackChunkSize;
+        Reallocate ( num_events );
     }
 }
 
 bool MIDITrack::Expand ( int increase_amount )
 {
-    int num_chunks_to_expand = ( int ) ( ( increase_amount / MIDITrackChunkSize ) + 1 );
-    int num_chunks_alloced = ( int ) ( buf_size / MIDITrackChunkSize );
-    int new_last_chunk_num = ( int ) ( num_chunks_to_expand + num_chunks_alloced );
-
-    if ( new_last_chunk_num >= MIDIChunksPerTrack )
+    if ( increase_amount <= 0 )
     {
-        return false;
+        // geometric growth keeps the amortized cost of PutEvent() constant
+        increase_amount = ( buf_size > 0 ) ? buf_size : MIDITrackMinimumSize;
     }
 
-    for ( int i = num_chunks_alloced; i < new_last_chunk_num; ++i )
+    return Reallocate ( buf_size + increase_amount );
+}
+
+bool MIDITrack::Reallocate ( int new_size )
+{
+    if ( new_size < num_events )
+        return false;
+
+    MIDITimedBigMessage *new_buf = 0;
+
+    if ( new_size > 0 )
     {
-        chunk[i] = new MIDITrackChunk;
+        // raw storage, events are constructed in place by PutEvent(); nothrow, so
+        // running out of memory makes Expand() and PutEvent() return false
+        new_buf = static_cast<MIDITimedBigMessage *> (
+                      ::operator new ( new_size * sizeof ( MIDITimedBigMessage ), std::nothrow ) );
 
-        if ( !chunk[i] )
-        {
-            buf_size = ( i - 1 ) * MIDITrackChunkSize;
+        if ( !new_buf )
             return false;
-        }
     }
 
-    buf_size = new_last_chunk_num * MIDITrackChunkSize;
+    // move the events to the new buffer, this does not copy any sysex data
+    for ( int i = 0; i < num_events; ++i )
+    {
+        new ( new_buf + i ) MIDITimedBigMessage ( std::move ( buf[i] ) );
+        buf[i].~MIDITimedBigMessage();
+    }
+
+    ::operator delete ( buf );
+    buf = new_buf;
+    buf_size = new_size;
     return true;
 }
 
-MIDITimedBigMessage * MIDITrack::GetEventAddress ( int event_num )
+bool MIDITrack::PutEvent ( const MIDITimedBigMessage &msg )
 {
-    return chunk[ event_num/ ( MIDITrackChunkSize ) ]->GetEventAddress (
-               ( event_num % MIDITrackChunkSize ) );
+    // msg may be one of our own events, which would move when we grow,
+    // but its sysex does not move
+    MIDITimedMessage m ( msg );
+    m.SetTime ( msg.GetTime() );
+    return PutEvent ( m, msg.GetSysEx() );
 }
 
-const MIDITimedBigMessage * MIDITrack::GetEventAddress ( int event_num ) const
+bool MIDITrack::PutEvent ( MIDITimedBigMessage &&msg )
 {
-    return chunk[ event_num/ ( MIDITrackChunkSize ) ]->GetEventAddress (
-               ( event_num % MIDITrackChunkSize ) );
-}
+    if ( num_events >= buf_size && buf <= &msg && &msg < buf + buf_size )
+    {
+        // msg is one of our own events, which would move when we grow
+        MIDITimedBigMessage tmp ( std::move ( msg ) );
+        return PutEvent ( std::move ( tmp ) );
+    }
 
-bool MIDITrack::PutEvent ( const MIDITimedBigMessage &msg )
-{
-    if ( num_events >= buf_size )
+    if ( msg.IsSysExAttached() )
     {
-        if ( !Expand() )
-            return false;
+        // an attached sysex of someone else, typically of another track, must be copied
+        return PutEvent ( static_cast<const MIDITimedBigMessage &> ( msg ) );
     }
 
-    GetEventAddress ( num_events++ )->Copy ( msg );
+    if ( num_events >= buf_size && !Expand() )
+        return false;
+
+    new ( buf + num_events ) MIDITimedBigMessage ( std::move ( msg ) );
+    ++num_events;
+    Changed();
+
+    if ( ordered_events == num_events - 1 )
+        ExtendOrderedEvents();
+
     return true;
 }
 
@@ -521,7 +797,7 @@ bool MIDITrack::PutEvent ( const MIDIDeltaTimedBigMessage &msg )
 
 bool MIDITrack::PutEvent2 ( MIDITimedBigMessage &msg )
 {
-    if ( PutEvent ( msg ) )
+    if ( PutEvent ( std::move ( msg ) ) )
     {
         MIDIClockTime t = msg.GetTime();
         msg.Clear();
@@ -533,8 +809,53 @@ bool MIDITrack::PutEvent2 ( MIDITimedBigMessage &msg )
 
 bool MIDITrack::PutEvent ( const MIDITimedMessage &msg, const MIDISystemExclusive *sysex )
 {
-    MIDITimedBigMessage m ( msg, sysex );
-    return PutEvent ( m );
+    if ( num_events >= buf_size && !Expand() )
+        return false;
+
+    MIDITimedBigMessage *ev = new ( buf + num_events ) MIDITimedBigMessage ( msg );
+
+    if ( sysex && !PutPayload ( ev, sysex ) )
+    {
+        ev->~MIDITimedBigMessage();
+        return false;
+    }
+
+    ++num_events;
+    Changed();
+
+    if ( ordered_events == num_events - 1 )
+        ExtendOrderedEvents();
+
+    return true;
+}
+
+bool MIDITrack::PutPayload ( MIDITimedBigMessage *ev, const MIDISystemExclusive *sysex )
+{
+    int len = sysex->GetLengthSE();
+
+    if ( len <= MIDISystemExclusive::INLINE_SIZE )
+    {
+        // short data is stored inside the sysex object
+        void *p = payload.Allocate ( sizeof ( MIDISystemExclusive ) );
+
+        if ( !p )
+            return false;
+
+        MIDISystemExclusive view ( const_cast<unsigned char *> ( sysex->GetBuf() ), len, len, false );
+        ev->AttachSysEx ( new ( p ) MIDISystemExclusive ( view ) );
+        return true;
+    }
+
+    // the sysex object and its data share one piece of the arena
+    void *p = payload.Allocate ( sizeof ( MIDISystemExclusive ) + len );
+
+    if ( !p )
+        return false;
+
+    unsigned char *data = static_cast<unsigned char *> ( p ) + sizeof ( MIDISystemExclusive );
+    memcpy ( data, sysex->GetBuf(), len );
+    ev->AttachSysEx ( new ( p ) MIDISystemExclusive ( data, len, len, false ) );
+    return true;
 }
 
 bool MIDITrack::PutTextEvent ( MIDIClockTime time, int meta_event_type, const char *text, int length )
@@ -546,11 +867,8 @@ bool MIDITrack::PutTextEvent ( MIDIClockTime time, int meta_event_type, const ch
     if ( length == 0 )
         length = (int) strlen( text );
 
-    MIDISystemExclusive sysex( length );
-
-    for ( int i = 0; i < length; ++i )
-        sysex.PutSysByte ( text[i] );
-
+    // PutEvent() copies the text, so the sysex can simply refer to it
+    MIDISystemExclusive sysex( (unsigned char *) text, length, length, false );
     return PutEvent( msg, &sysex );
 }
 
@@ -575,8 +893,20 @@ bool MIDITrack::SetEvent ( int event_num, const MIDITimedBigMessage &msg )
     }
     else
     {
-        GetEventAddress ( event_num )->Copy ( msg );
-        return true;
+        MIDITimedBigMessage *ev = &buf[event_num];
+        bool ok = true;
+
+        // else the caller may have changed the event through GetEvent()
+        if ( ev != &msg )
+        {
+            MIDITimedMessage m ( msg );
+            m.SetTime ( msg.GetTime() );
+            ev->Copy ( m );
+            ok = ( msg.GetSysEx() == 0 ) || PutPayload ( ev, msg.GetSysEx() );
+        }
+
+        MarkModified ( event_num );
+        return ok;
     }
 }
 
@@ -588,23 +918,88 @@ bool MIDITrack::MakeEventNoOp ( int event_num )
     }
     else
     {
-        MIDITimedBigMessage *ev = GetEventAddress ( event_num );
-        if ( ev )
-            ev->SetNoOp();
+        // the time of the event is kept, so the events stay in order
+        buf[event_num].SetNoOp();
+        Changed();
         return true;
     }
 }
 
+bool MIDITrack::MarkModified ( int event_num )
+{
+    if ( !IsValidEventNum( event_num ) )
+        return false;
+
+    Verify();
+    Changed();
+
+    if ( event_num < ordered_events )
+    {
+        MIDIClockTime t = buf[event_num].GetTime();
+
+        if ( ( event_num > 0 && buf[event_num-1].GetTime() > t ) ||
+             ( event_num + 1 < ordered_events && t > buf[event_num+1].GetTime() ) )
+        {
+            // out of order edit
+            ordered_events = event_num;
+        }
+        else if ( time_index_step > 0 && event_num % time_index_step == 0 )
+        {
+            time_index[event_num / time_index_step] = t;
+        }
+    }
+
+    return true;
+}
+
+int MIDITrack::OrderedLowerBound ( MIDIClockTime time ) const
+{
+    int lo = 0;
+    int hi = ordered_events;
+
+    if ( time_index_step > 0 && ordered_events > 0 )
+    {
+        // find the run of step events which holds the result
+        int entries = ( ordered_events + time_index_step - 1 ) / time_index_step;
+        int j = (int) ( std::lower_bound ( time_index.begin(), time_index.begin() + entries, time ) - time_index.begin() );
+
+        if ( j > 0 )
+            lo = ( j - 1 ) * time_index_step + 1;
+
+        if ( j < entries )
+            hi = j * time_index_step;
+    }
+
+    while ( lo < hi )
+    {
+        int mid = ( lo + hi ) / 2;
+
+        if ( buf[mid].GetTime() < time )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
 bool MIDITrack::FindEventNumber ( MIDIClockTime time, int *event_num ) const
 {
     ENTER ( "MIDITrack::FindEventNumber( int , int * )" );
-    // TO DO: try make this a binary search
 
-    for ( int i = 0; i < num_events; ++i )
+    Verify();
+
+    int i = OrderedLowerBound ( time );
+
+    if ( i < ordered_events )
     {
-        const MIDITimedBigMessage *msg = GetEventAddress ( i );
+        *event_num = i;
+        return true;
+    }
 
-        if ( msg->GetTime() >= time )
+    for ( ; i < num_events; ++i )
+    {
+        if ( buf[i].GetTime() >= time )
         {
             *event_num = i;
             return true;
@@ -615,6 +1010,45 @@ bool MIDITrack::FindEventNumber ( MIDIClockTime time, int *event_num ) const
     return false;
 }
 
+bool MIDITrack::FindLastEventNumberBefore ( MIDIClockTime time, int *event_num ) const
+{
+    Verify();
+
+    int i;
+
+    for ( i = num_events - 1; i >= ordered_events; --i )
+    {
+        if ( buf[i].GetTime() < time )
+        {
+            *event_num = i;
+            return true;
+        }
+    }
+
+    *event_num = OrderedLowerBound ( time ) - 1;
+    return *event_num >= 0;
+}
+
+int MIDITrack::GetNumEventsInTimeRange ( MIDIClockTime start_time, MIDIClockTime end_time ) const
+{
+    if ( start_time >= end_time )
+        return 0;
+
+    Verify();
+
+    int count = OrderedLowerBound ( end_time ) - OrderedLowerBound ( start_time );
+
+    for ( int i = ordered_events; i < num_events; ++i )
+    {
+        MIDIClockTime t = buf[i].GetTime();
+
+        if ( start_time <= t && t < end_time )
+            ++count;
+    }
+
+    return count;
+}
+
 const MIDITimedBigMessage *MIDITrack::GetEvent ( int event_num ) const
 {
     if ( !IsValidEventNum( event_num ) )
@@ -47,7 +47,7 @@ void SoloMelodyConverter( const MIDIMultiTrack &src, MIDIMultiTrack &dst, int ig
     if ( !seq.GetNextEventTime ( &ev_time ) )
         return; // empty src multitrack
 
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
     int ev_track;
 
     int solo_note = -1; // highest midi note number in current time, valid values 0...127
@@ -55,45 +55,45 @@ void SoloMelodyConverter( const MIDIMultiTrack &src, MIDIMultiTrack &dst, int ig
     MIDITimedBigMessage solo_note_on_ev; // last solo note on event
     solo_note_on_ev.SetNoOp();
 
-    while ( seq.GetNextEvent( &ev_track, &ev ) )
+    while ( seq.GetNextEventRef( &ev_track, &ev ) )
     {
-        if ( ev.IsServiceMsg() || ev.IsNoOp() )
+        if ( ev->IsServiceMsg() || ev->IsNoOp() )
             continue;
 
-        if ( ev.IsChannelEvent() )
+        if ( ev->IsChannelEvent() )
         {
-            if ( ev.GetChannel() == ignore_channel )
+            if ( ev->GetChannel() == ignore_channel )
                 continue;
 
-//          if ( ev.IsAllNotesOff() ) ... ; // for future work...
+//          if ( ev->IsAllNotesOff() ) ... ; // for future work...
 
-            if ( ev.IsNote() )
+            if ( ev->IsNote() )
             {
-                int new_note = ev.GetNote();
+                int new_note = ev->GetNote();
 
                 // skip all note events if new note lower than solo note
                 if ( new_note < solo_note )
                     continue;
                 // else ( new_note >= solo_note )
 
-                if ( ev.ImplicitIsNoteOn() ) // new note on event
+                if ( ev->ImplicitIsNoteOn() ) // new note on event
                 {
                     if ( solo_note_on ) // new note on after previous solo note on
                     {
                         // make noteoff message for previous solo note
-                        solo_note_on_ev.SetTime( ev.GetTime() );
+                        solo_note_on_ev.SetTime( ev->GetTime() );
                         solo_note_on_ev.SetVelocity( 0 ); // note off
-                        dst.GetTrack(ev_track)->PutEvent( solo_note_on_ev );
+                        dst.GetTrack(ev_track)->PutEvent( std::move( solo_note_on_ev ) );
 
                         // make new solo note
-                        solo_note_on_ev = ev;
+                        solo_note_on_ev = *ev;
                         solo_note = new_note;
                     }
                     else // ( solo_note_on == false ) - new note on after previous silence
                     {
                         // make new solo note
                         solo_note_on = true;
-                        solo_note_on_ev = ev;
+                        solo_note_on_ev = *ev;
                         solo_note = new_note;
                     }
                 }
@@ -104,7 +104,7 @@ void SoloMelodyConverter( const MIDIMultiTrack &src, MIDIMultiTrack &dst, int ig
                         if ( new_note == solo_note ) // solo note off event
                         {
                             // test channels of the events
-                            if ( ev.GetChannel() == solo_note_on_ev.GetChannel() )
+                            if ( ev->GetChannel() == solo_note_on_ev.GetChannel() )
                             {
                                 solo_note_on = false;
                                 solo_note = -1; // erase solo_note
@@ -120,7 +120,7 @@ void SoloMelodyConverter( const MIDIMultiTrack &src, MIDIMultiTrack &dst, int ig
                 }
             }
         }
-        dst.GetTrack(ev_track)->PutEvent(ev);
+        dst.GetTrack(ev_track)->PutEvent( *ev );
     }
 }
 
@@ -135,18 +135,18 @@ void CopyWithoutChannel( const MIDIMultiTrack &src, MIDIMultiTrack &dst, int ign
     if ( !seq.GetNextEventTime ( &ev_time ) )
         return; // empty src multitrack
 
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
     int ev_track;
 
-    while ( seq.GetNextEvent( &ev_track, &ev ) )
+    while ( seq.GetNextEventRef( &ev_track, &ev ) )
     {
-        if ( ev.IsServiceMsg() || ev.IsNoOp() )
+        if ( ev->IsServiceMsg() || ev->IsNoOp() )
             continue;
 
-        if ( ev.IsChannelEvent() && ev.GetChannel() == ignore_channel )
+        if ( ev->IsChannelEvent() && ev->GetChannel() == ignore_channel )
             continue;
 
-        dst.GetTrack(ev_track)->PutEvent(ev);
+        dst.GetTrack(ev_track)->PutEvent( *ev );
     }
 }
 
@@ -196,7 +196,7 @@ void CompressStartPause( const MIDIMultiTrack &src, MIDIMultiTrack &dst, int ign
             ev.SetTime( ev_time - ev_time0 );
         }
 
-        dst.GetTrack(ev_track)->PutEvent(ev);
+        dst.GetTrack(ev_track)->PutEvent( std::move( ev ) );
     }
 }
 
@@ -213,15 +213,15 @@ void ClipMultiTrack( const MIDIMultiTrack &src, MIDIMultiTrack &dst, double max_
     if ( !seq.GetNextEventTimeMs ( &event_time ) )
         return; // empty src multitrack
 
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
     int ev_track;
-    while ( seq.GetNextEvent( &ev_track, &ev ) )
+    while ( seq.GetNextEventRef( &ev_track, &ev ) )
     {
         // ignore NoOp, BeatMarker and other Service messages
-        if ( ev.IsServiceMsg() || ev.IsNoOp() )
+        if ( ev->IsServiceMsg() || ev->IsNoOp() )
             continue;
 
-        dst.GetTrack(ev_track)->PutEvent(ev);
+        dst.GetTrack(ev_track)->PutEvent( *ev );
 
         if ( event_time >= max_event_time )
             break; // end of max_time_sec
@@ -239,23 +239,27 @@ void CollapseMultiTrack( const MIDIMultiTrack &src, MIDIMultiTrack &dst )
     MIDISequencer seq( &src );
     seq.GoToZero();
 
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
     int ev_track;
-    while ( seq.GetNextEvent( &ev_track, &ev ) )
+    MIDIClockTime end_time = 0;
+    while ( seq.GetNextEventRef( &ev_track, &ev ) )
     {
+        end_time = ev->GetTime();
+
         // ignore all src EndOfTrack messages!!
-        if ( ev.IsDataEnd() )
+        if ( ev->IsDataEnd() )
             continue;
 
         // ignore NoOp, BeatMarker and other Service messages
-        if ( ev.IsServiceMsg() || ev.IsNoOp() )
+        if ( ev->IsServiceMsg() || ev->IsNoOp() )
             continue;
 
-        dst.GetTrack(0)->PutEvent(ev);
+        dst.GetTrack(0)->PutEvent( *ev );
     }
 
     // set (single!) dst EndOfTrack message
-    MIDITimedBigMessage end(ev); // copy time of last src event
+    MIDITimedBigMessage end;
+    end.SetTime( end_time ); // copy time of last src event
     end.SetDataEnd();
     dst.GetTrack(0)->PutEvent(end);
 }
@@ -266,10 +270,10 @@ void CollapseAndExpandMultiTrack( const MIDIMultiTrack &src, MIDIMultiTrack &dst
     dst.AssignEventsToTracks(0);
 }
 
-bool ReadMidiFile(const char *file, MIDIMultiTrack &dst)
+bool ReadMidiFile(const char *file, MIDIMultiTrack &dst, bool presize_tracks)
 {
     MIDIFileReadStreamFile rs( file );
-    MIDIFileReadMultiTrack track_loader( &dst );
+    MIDIFileReadMultiTrack track_loader( &dst, presize_tracks );
     MIDIFileRead reader( &rs, &track_loader );
     // set amount of dst tracks equal to midifile
     dst.ClearAndResize( reader.ReadNumTracks() );
@@ -277,6 +281,33 @@ bool ReadMidiFile(const char *file, MIDIMultiTrack &dst)
     return reader.Parse();
 }
 
+bool ReadMidiFileMetadata(const char *file, MIDIFileMetadata &dst)
+{
+    dst.Clear();
+
+    MIDIFileReadStreamFile rs( file );
+    if ( !rs.IsValid() )
+        return false;
+
+    MIDIFileReadMetadata scanner( &dst );
+    MIDIFileRead reader( &rs, &scanner );
+    return reader.Parse();
+}
+
+bool ReadMidiFileParallel(const char *file, MIDIMultiTrack &dst, int num_threads)
+{
+    MIDIFileReadStreamMapped rs( file );
+    if ( !rs.IsValid() )
+        return false;
+
+    const unsigned char *data;
+    unsigned long length = rs.ReadBlock( &data );
+
+    // the mapping is private, so the payloads can be parsed in place
+    MIDIFileReadMultiTrackParallel loader( &dst, num_threads );
+    return loader.Parse( data, length, true );
+}
+
 bool WriteMidiFile(const MIDIMultiTrack &src, const char *file, bool use_running_status)
 {
     MIDIFileWriteStreamFileName out_stream( file );
@@ -292,10 +323,36 @@ bool WriteMidiFile(const MIDIMultiTrack &src, const char *file, bool use_running
     return writer.Write( tracks_number );
 }
 
+bool WriteMidiFileParallel(const MIDIMultiTrack &src, const char *file, int num_threads, bool use_running_status)
+{
+    MIDIFileWriteStreamFileName out_stream( file );
+    if ( !out_stream.IsValid() )
+        return false;
+
+    MIDIFileWriteMultiTrack writer( &src, &out_stream, num_threads );
+    writer.UseRunningStatus( use_running_status );
+    return writer.Write( src.GetNumTracksWithEvents() );
+}
+
+bool WriteMidiFile(const MIDIMultiTrack &src, std::vector<unsigned char> &dst, bool use_running_status)
+{
+    MIDIFileWriteStreamMemory out_stream;
+    bool ok;
+
+    {
+        MIDIFileWriteMultiTrack writer( &src, &out_stream );
+        writer.UseRunningStatus( use_running_status );
+        ok = writer.Write( src.GetNumTracksWithEvents() );
+    }
+
+    if ( ok )
+        dst.swap( out_stream.GetBuffer() );
+    return ok;
+}
+
 double GetMisicDurationInSeconds(const MIDIMultiTrack &mt)
 {
-    MIDISequencer seq( &mt );
-    return seq.GetMisicDurationInSeconds();
+    return 0.001 * mt.GetDurationMs();
 }
 
 std::string MultiTrackAsText(const MIDIMultiTrack &mt)
@@ -304,19 +361,19 @@ std::string MultiTrackAsText(const MIDIMultiTrack &mt)
     seq.GoToZero();
 
     int track;
-    MIDITimedBigMessage ev;
+    const MIDITimedBigMessage *ev;
 
     std::ostringstream ostr;
     ostr << "Clocks per beat  "  << mt.GetClksPerBeat() << std::endl << std::endl;
-    while ( seq.GetNextEvent( &track, &ev ) )
+    while ( seq.GetNextEventRef( &track, &ev ) )
     {
-        if ( ev.IsBeatMarker() ) continue;
+        if ( ev->IsBeatMarker() ) continue;
 
         MIDIClockTime midi_time = seq.GetCurrentMIDIClockTime();
         double msec_time = seq.GetCurrentTimeInMs();
 
         char buf[256];
-        ev.MsgToText( buf );
+        ev->MsgToText( buf );
 
         ostr << "Track " << track;
         ostr << "  Midi tick " << midi_time;
@@ -353,6 +410,7 @@ void LastEventsProlongation( MIDIMultiTrack &tracks, int track_num, MIDIClockTim
     while ( msg->GetTime() == tmax )
     {
         msg->SetTime( tmax + add_ticks );
+        track->MarkModified( index );
         if ( --index < 0 )
             break;
         msg = track->GetEvent( index );